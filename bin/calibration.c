@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "calibration.h"
+
+#define CPUINFO_FILE "/proc/cpuinfo"
+#define GOVERNOR_FILE "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor"
+#define CAPACITY_FILE "/sys/devices/system/cpu/cpu%d/cpu_capacity"
+
+#define CACHE_HEADER "# rtspin calibration cache: cpu, capacity, " \
+	"microcode, governor, ns per loop, overhead ns, model\n"
+#define CACHE_FIELDS 7
+
+/* number of distinct loop counts and samples per count used by calib_fit() */
+#define FIT_POINTS  16
+#define FIT_SAMPLES 9
+/* shortest probe, in loop iterations */
+#define FIT_MIN_LOOPS 64
+/* outlier threshold in (normal-consistent) median absolute deviations */
+#define FIT_MAX_MADS 3.0
+#define MAD_TO_SIGMA 1.4826
+/* two-sided 95% quantile of the normal distribution */
+#define Z_95 1.96
+
+#define NUMS 4096
+static int num[NUMS];
+
+noinline int calib_workload(int count)
+{
+	int i, j = 0;
+	/* touch some numbers and do some math */
+	for (i = 0; i < count; i++) {
+		int index = i % NUMS;
+		j += num[index]++;
+		if (j > num[index])
+			num[index] = (j / 2) + 1;
+	}
+	return j;
+}
+
+static double thread_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1E9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double*) a, y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+static double median(double *sorted, int n)
+{
+	return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+static double time_workload(calib_workload_t workload, int loops)
+{
+	double start = thread_time_ns();
+	workload(loops);
+	return thread_time_ns() - start;
+}
+
+int calib_fit(calib_workload_t workload, double max_probe_ms,
+	      struct calib_model *model)
+{
+	double target_ns = max_probe_ms * 1E6;
+	double t[FIT_SAMPLES], dev[FIT_SAMPLES];
+	double xs[FIT_POINTS * FIT_SAMPLES], ys[FIT_POINTS * FIT_SAMPLES];
+	double ws[FIT_POINTS * FIT_SAMPLES];
+	double med, mad, limit, elapsed, step, r;
+	double sw = 0, mean_x = 0, mean_y = 0, sxx = 0, sxy = 0, ssr = 0, s2;
+	int max_loops = FIT_MIN_LOOPS, loops;
+	int p, i, n = 0;
+
+	memset(model, 0, sizeof(*model));
+
+	/* warm up and find the largest loop count to probe */
+	while ((elapsed = time_workload(workload, max_loops)) < target_ns / 2
+	       && max_loops < INT_MAX / 2)
+		max_loops *= 2;
+	if (elapsed > 0 && elapsed < target_ns)
+		max_loops = fmin(max_loops * (target_ns / elapsed), INT_MAX);
+
+	/* Probe geometrically spaced loop counts so that both the fixed
+	 * overhead (short probes) and the per-loop cost (long probes) are
+	 * well determined. */
+	step = pow((double) max_loops / FIT_MIN_LOOPS, 1.0 / (FIT_POINTS - 1));
+
+	for (p = 0; p < FIT_POINTS; p++) {
+		loops = (int) (FIT_MIN_LOOPS * pow(step, p));
+
+		for (i = 0; i < FIT_SAMPLES; i++)
+			t[i] = time_workload(workload, loops);
+
+		/* robust location and scale of this point */
+		qsort(t, FIT_SAMPLES, sizeof(double), cmp_double);
+		med = median(t, FIT_SAMPLES);
+		for (i = 0; i < FIT_SAMPLES; i++)
+			dev[i] = fabs(t[i] - med);
+		qsort(dev, FIT_SAMPLES, sizeof(double), cmp_double);
+		mad = median(dev, FIT_SAMPLES) * MAD_TO_SIGMA;
+		/* avoid rejecting everything if the samples are identical */
+		limit = FIT_MAX_MADS * fmax(mad, med * 1E-4);
+
+		for (i = 0; i < FIT_SAMPLES; i++) {
+			if (fabs(t[i] - med) > limit) {
+				model->rejected++;
+				continue;
+			}
+			xs[n] = loops;
+			ys[n] = t[i];
+			/* timing noise grows with the probe length */
+			ws[n] = 1.0 / (med * med);
+			n++;
+		}
+	}
+
+	if (n < 3)
+		return -1;
+
+	/* weighted least squares: y = overhead + ns_per_loop * x */
+	for (i = 0; i < n; i++) {
+		sw += ws[i];
+		mean_x += ws[i] * xs[i];
+		mean_y += ws[i] * ys[i];
+	}
+	mean_x /= sw;
+	mean_y /= sw;
+	for (i = 0; i < n; i++) {
+		sxx += ws[i] * (xs[i] - mean_x) * (xs[i] - mean_x);
+		sxy += ws[i] * (xs[i] - mean_x) * (ys[i] - mean_y);
+	}
+	if (sxx <= 0)
+		return -1;
+
+	model->ns_per_loop = sxy / sxx;
+	model->overhead_ns = mean_y - model->ns_per_loop * mean_x;
+	model->samples = n;
+
+	for (i = 0; i < n; i++) {
+		r = ys[i] - model->overhead_ns - model->ns_per_loop * xs[i];
+		ssr += ws[i] * r * r;
+	}
+	s2 = ssr / (n - 2);
+	model->ns_per_loop_ci = Z_95 * sqrt(s2 / sxx);
+	model->overhead_ci = Z_95 * sqrt(s2 * (1.0 / sw + mean_x * mean_x / sxx));
+
+	/* a negative overhead is just noise */
+	if (model->overhead_ns < 0)
+		model->overhead_ns = 0;
+
+	return model->ns_per_loop > 0 ? 0 : -1;
+}
+
+/* Copy a value from /proc/cpuinfo, dropping the trailing newline and any
+ * tabs, which serve as field separators in the cache file. */
+static void copy_value(char *dst, size_t len, const char *src)
+{
+	size_t i;
+
+	while (*src == ' ')
+		src++;
+	for (i = 0; i + 1 < len && src[i] && src[i] != '\n'; i++)
+		dst[i] = src[i] == '\t' ? ' ' : src[i];
+	dst[i] = '\0';
+}
+
+/* split "key<tabs>: value" lines, returns value or NULL */
+static char* cpuinfo_value(char *line, const char *key)
+{
+	size_t n = strlen(key);
+	char *colon;
+
+	if (strncmp(line, key, n) != 0 || (line[n] != '\t' && line[n] != ' '
+					   && line[n] != ':'))
+		return NULL;
+	colon = strchr(line + n, ':');
+	return colon ? colon + 1 : NULL;
+}
+
+int calib_key_for_cpu(int cpu, struct calib_key *key)
+{
+	FILE *f;
+	char line[256], fname[80];
+	char part[32] = "", implementer[32] = "", variant[32] = "";
+	char *val;
+	int cur = -1, found = 0;
+
+	memset(key, 0, sizeof(*key));
+	key->cpu = cpu;
+	strcpy(key->microcode, "-");
+	strcpy(key->governor, "-");
+
+	f = fopen(CPUINFO_FILE, "r");
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		if ((val = cpuinfo_value(line, "processor"))) {
+			cur = atoi(val);
+			if (cur == cpu)
+				found = 1;
+			continue;
+		}
+		if (cur != cpu)
+			continue;
+		/* x86 */
+		if ((val = cpuinfo_value(line, "model name")))
+			copy_value(key->model, sizeof(key->model), val);
+		else if ((val = cpuinfo_value(line, "microcode")))
+			copy_value(key->microcode, sizeof(key->microcode), val);
+		/* ARM */
+		else if ((val = cpuinfo_value(line, "CPU implementer")))
+			copy_value(implementer, sizeof(implementer), val);
+		else if ((val = cpuinfo_value(line, "CPU part")))
+			copy_value(part, sizeof(part), val);
+		else if ((val = cpuinfo_value(line, "CPU variant")))
+			copy_value(variant, sizeof(variant), val);
+	}
+	fclose(f);
+
+	if (!found)
+		return -1;
+
+	if (!key->model[0])
+		snprintf(key->model, sizeof(key->model),
+			 "implementer %s part %s variant %s",
+			 implementer[0] ? implementer : "?",
+			 part[0] ? part : "?",
+			 variant[0] ? variant : "?");
+
+	snprintf(fname, sizeof(fname), GOVERNOR_FILE, cpu);
+	f = fopen(fname, "r");
+	if (f) {
+		if (fgets(line, sizeof(line), f))
+			copy_value(key->governor, sizeof(key->governor), line);
+		fclose(f);
+	}
+
+	/* only reported on asymmetric systems */
+	key->capacity = -1;
+	snprintf(fname, sizeof(fname), CAPACITY_FILE, cpu);
+	f = fopen(fname, "r");
+	if (f) {
+		if (fgets(line, sizeof(line), f))
+			key->capacity = atoi(line);
+		fclose(f);
+	}
+
+	return 0;
+}
+
+int calib_same_class(const struct calib_key *a, const struct calib_key *b)
+{
+	return a->capacity == b->capacity &&
+	       !strcmp(a->model, b->model) &&
+	       !strcmp(a->microcode, b->microcode) &&
+	       !strcmp(a->governor, b->governor);
+}
+
+int calib_cache_default_path(char *buf, size_t len)
+{
+	const char *dir;
+	int n;
+
+	dir = getenv("RTSPIN_CALIBRATION_CACHE");
+	if (dir)
+		n = snprintf(buf, len, "%s", dir);
+	else if ((dir = getenv("XDG_CACHE_HOME")))
+		n = snprintf(buf, len, "%s/rtspin-calibration", dir);
+	else if ((dir = getenv("HOME")))
+		n = snprintf(buf, len, "%s/.cache/rtspin-calibration", dir);
+	else
+		return -1;
+
+	return n > 0 && n < len ? 0 : -1;
+}
+
+/* Parse one cache line. The model comes last since it may contain spaces. */
+static int parse_entry(char *line, struct calib_key *key,
+		       struct calib_model *model)
+{
+	char *field[CACHE_FIELDS];
+	int i;
+
+	if (line[0] == '#')
+		return -1;
+
+	memset(model, 0, sizeof(*model));
+	field[0] = line;
+	for (i = 1; i < CACHE_FIELDS; i++) {
+		field[i] = strchr(field[i - 1], '\t');
+		if (!field[i])
+			return -1;
+		*field[i]++ = '\0';
+	}
+
+	key->cpu = atoi(field[0]);
+	key->capacity = atoi(field[1]);
+	copy_value(key->microcode, sizeof(key->microcode), field[2]);
+	copy_value(key->governor, sizeof(key->governor), field[3]);
+	model->ns_per_loop = atof(field[4]);
+	model->overhead_ns = atof(field[5]);
+	copy_value(key->model, sizeof(key->model), field[6]);
+
+	return model->ns_per_loop > 0 ? 0 : -1;
+}
+
+static int same_key(const struct calib_key *a, const struct calib_key *b)
+{
+	return a->cpu == b->cpu && calib_same_class(a, b);
+}
+
+int calib_cache_lookup(const char *file, const struct calib_key *key,
+		       struct calib_model *model)
+{
+	FILE *f;
+	char line[512];
+	struct calib_key entry;
+	struct calib_model cached;
+	int found = 0;
+
+	f = fopen(file, "r");
+	if (!f)
+		return -1;
+
+	while (!found && fgets(line, sizeof(line), f)) {
+		if (parse_entry(line, &entry, &cached) == 0 &&
+		    same_key(&entry, key)) {
+			*model = cached;
+			found = 1;
+		}
+	}
+	fclose(f);
+
+	return found ? 0 : -1;
+}
+
+static void make_parent_dir(const char *file)
+{
+	char dir[PATH_MAX];
+	char *slash;
+
+	snprintf(dir, sizeof(dir), "%s", file);
+	slash = strrchr(dir, '/');
+	if (slash && slash != dir) {
+		*slash = '\0';
+		mkdir(dir, 0755);
+	}
+}
+
+int calib_cache_store(const char *file, const struct calib_key *key,
+		      const struct calib_model *model)
+{
+	FILE *in, *out;
+	char line[512], copy[512], tmp[PATH_MAX];
+	struct calib_key entry;
+	struct calib_model cached;
+	int ok;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.%d", file, getpid()) >= sizeof(tmp))
+		return -1;
+
+	make_parent_dir(file);
+	out = fopen(tmp, "w");
+	if (!out)
+		return -1;
+
+	fputs(CACHE_HEADER, out);
+
+	/* keep the entries of all other CPUs */
+	in = fopen(file, "r");
+	if (in) {
+		while (fgets(line, sizeof(line), in)) {
+			strcpy(copy, line);
+			if (parse_entry(copy, &entry, &cached) == 0 &&
+			    entry.cpu != key->cpu)
+				fputs(line, out);
+		}
+		fclose(in);
+	}
+
+	fprintf(out, "%d\t%d\t%s\t%s\t%.6f\t%.1f\t%s\n", key->cpu,
+		key->capacity, key->microcode, key->governor, model->ns_per_loop,
+		model->overhead_ns, key->model);
+
+	ok = fclose(out) == 0;
+	if (ok)
+		ok = rename(tmp, file) == 0;
+	if (!ok)
+		unlink(tmp);
+
+	return ok ? 0 : -1;
+}
@@ -4,6 +4,10 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "common.h"
 
@@ -119,3 +123,169 @@ double* csv_read_column(const char *file, int column, int *num_rows)
 
 	return values;
 }
+
+void spin_for(lt_t ns)
+{
+	lt_t end = litmus_clock() + ns;
+
+	while (litmus_clock() < end)
+		/* busy wait */;
+}
+
+int count_domains(void)
+{
+	unsigned long long mask;
+	int d;
+
+	for (d = 0; domain_to_cpus(d, &mask) == 0; d++)
+		;
+	return d;
+}
+
+int run_released_tasks(int num_tasks, int rounds, lt_t delay,
+		       int (*task)(int idx, void *arg), void *arg)
+{
+	pid_t *pids;
+	int i, r, status, waiters, failed = 0, exited = 0;
+
+	pids = calloc(num_tasks, sizeof(pid_t));
+	if (!pids)
+		bail_out("couldn't allocate memory");
+
+	for (i = 0; i < num_tasks; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			bail_out("fork() failed");
+		if (pids[i] == 0)
+			_exit(task(i, arg));
+	}
+
+	for (r = 0; r < rounds && !failed; r++) {
+		/* wait for all tasks, unless one of them gave up */
+		while ((waiters = get_nr_ts_release_waiters()) >= 0 &&
+		       waiters + exited < num_tasks) {
+			while (waitpid(-1, &status, WNOHANG) > 0) {
+				exited++;
+				failed = 1;
+			}
+			usleep(100);
+		}
+		if (waiters < 0) {
+			failed = 1;
+			break;
+		}
+		if (release_ts(&delay) < 0)
+			bail_out("release_ts()");
+	}
+
+	for (i = 0; i < num_tasks; i++) {
+		/* the others would wait for a release forever */
+		if (failed)
+			kill(pids[i], SIGKILL);
+		if (waitpid(pids[i], &status, 0) == pids[i] &&
+		    (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+			failed = 1;
+	}
+
+	free(pids);
+	return failed ? -1 : 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+	return (x > y) - (x < y);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+	return (x > y) - (x < y);
+}
+
+static unsigned long long sample_at(const void *samples, size_t size, int i)
+{
+	if (size == sizeof(uint32_t))
+		return ((const uint32_t*) samples)[i];
+	return ((const uint64_t*) samples)[i];
+}
+
+void sample_stats(void *samples, size_t size, int n,
+		  struct sample_stats *stats)
+{
+	double sum = 0;
+	int i;
+
+	assert(size == sizeof(uint32_t) || size == sizeof(uint64_t));
+	assert(n > 0);
+
+	qsort(samples, n, size, size == sizeof(uint32_t) ? cmp_u32 : cmp_u64);
+	for (i = 0; i < n; i++)
+		sum += sample_at(samples, size, i);
+
+	stats->n = n;
+	stats->min = sample_at(samples, size, 0);
+	stats->p50 = sample_at(samples, size, n / 2);
+	stats->p90 = sample_at(samples, size, (int) (n * 0.9));
+	stats->p99 = sample_at(samples, size, (int) (n * 0.99));
+	stats->p999 = sample_at(samples, size, (int) (n * 0.999));
+	stats->max = sample_at(samples, size, n - 1);
+	stats->mean = sum / n;
+}
+
+void print_sample_stats(const struct sample_stats *stats)
+{
+	printf("%d,%llu,%llu,%llu,%llu,%llu,%.1f\n", stats->n, stats->min,
+	       stats->p50, stats->p90, stats->p99, stats->max, stats->mean);
+}
+
+long cache_size(int level)
+{
+	char path[128], buf[32];
+	FILE *f;
+	long size = 0, kb;
+	int idx, lvl;
+
+	for (idx = 0; !size; idx++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu0/cache/index%d/level", idx);
+		f = fopen(path, "r");
+		if (!f)
+			break;
+		if (fscanf(f, "%d", &lvl) != 1)
+			lvl = -1;
+		fclose(f);
+		if (lvl != level)
+			continue;
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu0/cache/index%d/type", idx);
+		f = fopen(path, "r");
+		if (!f || !fgets(buf, sizeof(buf), f) ||
+		    strncmp(buf, "Instruction", 11) == 0) {
+			if (f)
+				fclose(f);
+			continue;
+		}
+		fclose(f);
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu0/cache/index%d/size", idx);
+		f = fopen(path, "r");
+		if (f && fscanf(f, "%ldK", &kb) == 1)
+			size = kb * 1024;
+		if (f)
+			fclose(f);
+	}
+	return size;
+}
+
+long last_level_cache_size(void)
+{
+	long size, largest = 0;
+	int level;
+
+	for (level = 1; (size = cache_size(level)); level++)
+		largest = size;
+	return largest;
+}
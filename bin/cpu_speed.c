@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "litmus.h"
+#include "common.h"
+#include "calibration.h"
+
+const char *usage_msg =
+	"Usage: cpu_speed [OPTIONS]\n"
+	"\n"
+	"Calibrate rtspin's workload loop on every online CPU and print the\n"
+	"relative speed of each CPU, together with its capacity as reported\n"
+	"by the kernel and the LITMUS^RT scheduling domains it belongs to.\n"
+	"\n"
+	"Options:\n"
+	"    -m MS             length of the longest calibration probe (default: 20ms)\n"
+	"    -w                store the results in the rtspin calibration cache\n"
+	"    -K FILE           calibration cache to use with -w (default:\n"
+	"                      $RTSPIN_CALIBRATION_CACHE or ~/.cache/rtspin-calibration)\n"
+	"    -h                show this help message\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+struct cpu_result {
+	struct calib_key key;
+	struct calib_model model;
+	int cls;
+};
+
+#define OPTSTR "m:wK:h"
+
+int main(int argc, char** argv)
+{
+	int opt, cpu, other, num_cpus, num_classes = 0;
+	double max_probe_ms = 20;
+	double fastest = 0;
+	int store = 0;
+	char cache[PATH_MAX] = "";
+	char domains[32];
+	unsigned long long mask;
+	struct cpu_result *res;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 'm':
+			max_probe_ms = want_positive_double(optarg, "-m");
+			break;
+		case 'w':
+			store = 1;
+			break;
+		case 'K':
+			if (strlen(optarg) >= sizeof(cache))
+				usage("-K: path too long");
+			strcpy(cache, optarg);
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	if (store && !cache[0] &&
+	    calib_cache_default_path(cache, sizeof(cache)) != 0)
+		usage("Cannot determine location of calibration cache.");
+
+	num_cpus = num_online_cpus();
+	res = calloc(num_cpus, sizeof(*res));
+	if (!res)
+		bail_out("couldn't allocate memory");
+
+	for (cpu = 0; cpu < num_cpus; cpu++) {
+		if (calib_key_for_cpu(cpu, &res[cpu].key) != 0 ||
+		    be_migrate_to_cpu(cpu) != 0) {
+			fprintf(stderr, "could not calibrate CPU %d\n", cpu);
+			exit(EXIT_FAILURE);
+		}
+		if (calib_fit(calib_workload, max_probe_ms,
+			      &res[cpu].model) != 0) {
+			fprintf(stderr, "calibration of CPU %d failed\n", cpu);
+			exit(EXIT_FAILURE);
+		}
+		if (!fastest || res[cpu].model.ns_per_loop < fastest)
+			fastest = res[cpu].model.ns_per_loop;
+
+		/* number CPU classes in order of appearance */
+		res[cpu].cls = num_classes;
+		for (other = 0; other < cpu; other++)
+			if (calib_same_class(&res[cpu].key, &res[other].key)) {
+				res[cpu].cls = res[other].cls;
+				break;
+			}
+		if (res[cpu].cls == num_classes)
+			num_classes++;
+	}
+
+	printf("%4s %8s %5s %18s %10s %8s %8s  %s\n",
+	       "CPU", "capacity", "class", "domains", "ns/loop", "+/-",
+	       "speed", "model");
+	for (cpu = 0; cpu < num_cpus; cpu++) {
+		if (cpu_to_domains(cpu, &mask) == 0)
+			snprintf(domains, sizeof(domains), "0x%llx", mask);
+		else
+			strcpy(domains, "-");
+		printf("%4d %8d %5d %18s %10.4f %8.4f %8.3f  %s\n",
+		       cpu, res[cpu].key.capacity, res[cpu].cls, domains,
+		       res[cpu].model.ns_per_loop,
+		       res[cpu].model.ns_per_loop_ci,
+		       fastest / res[cpu].model.ns_per_loop,
+		       res[cpu].key.model);
+		if (store && calib_cache_store(cache, &res[cpu].key,
+					       &res[cpu].model) != 0)
+			fprintf(stderr, "could not update %s\n", cache);
+	}
+
+	if (store)
+		printf("Stored calibration in %s.\n", cache);
+
+	free(res);
+	return 0;
+}
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "litmus.h"
+#include "cs_spec.h"
+
+struct parser {
+	const char *str;
+	const char *pos;
+	struct cs_spec *spec;
+};
+
+static int parse_error(struct parser *p, const char *msg)
+{
+	fprintf(stderr, "invalid resource access specification '%s': "
+		"%s at offset %d\n", p->str, msg, (int) (p->pos - p->str));
+	return -1;
+}
+
+/* copy the next token up to one of the given delimiters */
+static int token(struct parser *p, const char *delim, char *buf, size_t len)
+{
+	size_t n = strcspn(p->pos, delim);
+
+	if (n == 0 || n >= len)
+		return -1;
+	memcpy(buf, p->pos, n);
+	buf[n] = '\0';
+	p->pos += n;
+	return 0;
+}
+
+static int number(struct parser *p, const char *delim, double *val)
+{
+	char buf[32], *end;
+
+	if (token(p, delim, buf, sizeof(buf)) != 0)
+		return -1;
+	*val = strtod(buf, &end);
+	return *end == '\0' ? 0 : -1;
+}
+
+static int parse_list(struct parser *p, int *first);
+
+/* does any access in the given list (or nested within it) use resource id? */
+static int uses_resource(struct cs_spec *spec, int idx, int id)
+{
+	for (; idx >= 0; idx = spec->access[idx].next_sibling)
+		if (spec->access[idx].resource_id == id ||
+		    uses_resource(spec, spec->access[idx].first_child, id))
+			return 1;
+	return 0;
+}
+
+/* PROTOCOL:ID:LENGTH[@PROBABILITY][{LIST}] */
+static int parse_access(struct parser *p, int *idx)
+{
+	struct cs_access *a;
+	char name[32];
+	double id, nested = 0;
+	int child;
+
+	if (p->spec->num_accesses == CS_SPEC_MAX_ACCESSES)
+		return parse_error(p, "too many accesses");
+
+	*idx = p->spec->num_accesses++;
+	a = p->spec->access + *idx;
+	memset(a, 0, sizeof(*a));
+	a->first_child = a->next_sibling = -1;
+	a->od = -1;
+	a->probability = 1;
+
+	if (token(p, ":", name, sizeof(name)) != 0 || *p->pos++ != ':')
+		return parse_error(p, "expected PROTOCOL:");
+	a->protocol = lock_protocol_for_name(name);
+	if (a->protocol < 0)
+		return parse_error(p, "unknown locking protocol");
+
+	if (number(p, ":", &id) != 0 || *p->pos++ != ':' ||
+	    id < 0 || id != (int) id)
+		return parse_error(p, "expected resource ID");
+	a->resource_id = (int) id;
+
+	if (number(p, "@{},", &a->length) != 0 || a->length <= 0)
+		return parse_error(p, "expected critical section length");
+	a->length *= 0.001;
+
+	if (*p->pos == '@') {
+		p->pos++;
+		if (number(p, "{},", &a->probability) != 0 ||
+		    a->probability < 0 || a->probability > 1)
+			return parse_error(p, "expected probability in [0, 1]");
+	}
+
+	if (*p->pos == '{') {
+		p->pos++;
+		if (parse_list(p, &a->first_child) != 0)
+			return -1;
+		if (*p->pos++ != '}')
+			return parse_error(p, "expected '}'");
+		if (uses_resource(p->spec, a->first_child, a->resource_id))
+			return parse_error(p, "resource nested in itself");
+		/* the kernel only supports nesting SRP in SRP and PCP in
+		 * PCP; it fails any other nested lock request with EBUSY */
+		for (child = a->first_child; child >= 0;
+		     child = p->spec->access[child].next_sibling) {
+			if ((a->protocol != SRP_SEM && a->protocol != PCP_SEM) ||
+			    p->spec->access[child].protocol != a->protocol)
+				return parse_error(p, "locking protocols "
+						   "cannot be nested");
+			nested += p->spec->access[child].length;
+		}
+		if (nested > a->length)
+			return parse_error(p, "nested critical sections "
+					   "exceed the enclosing one");
+	}
+
+	return 0;
+}
+
+static int parse_list(struct parser *p, int *first)
+{
+	int idx, prev = -1;
+
+	do {
+		if (parse_access(p, &idx) != 0)
+			return -1;
+		if (prev < 0)
+			*first = idx;
+		else
+			p->spec->access[prev].next_sibling = idx;
+		prev = idx;
+	} while (*p->pos == ',' && p->pos++);
+
+	return 0;
+}
+
+int cs_spec_parse(const char *str, struct cs_spec *spec)
+{
+	struct parser p = {str, str, spec};
+	int i, j;
+
+	memset(spec, 0, sizeof(*spec));
+	spec->first = -1;
+
+	if (parse_list(&p, &spec->first) != 0)
+		return -1;
+	if (*p.pos != '\0')
+		return parse_error(&p, "trailing characters");
+
+	/* a resource must be protected by the same protocol everywhere */
+	for (i = 0; i < spec->num_accesses; i++)
+		for (j = 0; j < i; j++)
+			if (spec->access[i].resource_id ==
+			    spec->access[j].resource_id &&
+			    spec->access[i].protocol != spec->access[j].protocol) {
+				fprintf(stderr, "resource %d used with "
+					"different locking protocols\n",
+					spec->access[i].resource_id);
+				return -1;
+			}
+
+	return 0;
+}
+
+int cs_spec_open_locks(struct cs_spec *spec, const char *name_space,
+		       void *config_param)
+{
+	int i, j;
+	struct cs_access *a;
+
+	for (i = 0; i < spec->num_accesses; i++) {
+		a = spec->access + i;
+		/* reuse the descriptor if the resource was opened before */
+		for (j = 0; j < i && a->od < 0; j++)
+			if (spec->access[j].resource_id == a->resource_id)
+				a->od = spec->access[j].od;
+		if (a->od >= 0)
+			continue;
+
+		a->od = litmus_open_lock(a->protocol, a->resource_id,
+					 name_space, config_param);
+		if (a->od < 0) {
+			fprintf(stderr, "could not open %s lock for resource "
+				"%d (%m)\n", name_for_lock_protocol(a->protocol),
+				a->resource_id);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void cs_access_record(struct cs_access *access, lt_t blocked)
+{
+	if (!access->count || blocked < access->min_blocking)
+		access->min_blocking = blocked;
+	if (blocked > access->max_blocking)
+		access->max_blocking = blocked;
+	access->total_blocking += blocked;
+	access->count++;
+}
+
+static void report_level(const struct cs_spec *spec, int idx, int depth,
+			 FILE *out)
+{
+	const struct cs_access *a;
+
+	for (; idx >= 0; idx = a->next_sibling) {
+		a = spec->access + idx;
+		fprintf(out, "%*s%s:%d (%.3fms): %lu accesses, blocking "
+			"min/avg/max = %.3f/%.3f/%.3fms\n", 2 * depth + 2, "",
+			name_for_lock_protocol(a->protocol), a->resource_id,
+			a->length * 1000, a->count,
+			ns2ms((double) a->min_blocking),
+			a->count ? ns2ms((double) a->total_blocking) / a->count : 0,
+			ns2ms((double) a->max_blocking));
+		report_level(spec, a->first_child, depth + 1, out);
+	}
+}
+
+void cs_spec_report(const struct cs_spec *spec, FILE *out)
+{
+	fprintf(out, "rtspin/%d: resource accesses:\n", getpid());
+	report_level(spec, spec->first, 0, out);
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "litmus.h"
+#include "common.h"
+#include "job_trace.h"
+
+const char *usage_msg =
+	"Usage: csv2trace [OPTIONS] CSV-FILE TRACE-FILE\n"
+	"\n"
+	"Convert per-job parameters from CSV-FILE into a binary job trace\n"
+	"that can be replayed with 'rtspin -F TRACE-FILE'.\n"
+	"\n"
+	"Options:\n"
+	"    -e COLUMN         column with execution times (default: 1)\n"
+	"    -a COLUMN         column with inter-arrival times\n"
+	"    -l COLUMN         column with critical section lengths\n"
+	"    -r COLUMN         column with accessed resource IDs (requires -l)\n"
+	"    -s COLUMN         column with self-suspension lengths\n"
+	"    -h                show this help message\n"
+	"\n"
+	"Units:\n"
+	"    All times in CSV-FILE are expected in milliseconds.\n"
+	"    Columns are numbered starting at one.\n"
+	"    A negative resource ID denotes a job without a critical section.\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static double* read_column(const char *file, int column, int num_rows)
+{
+	int rows;
+	double *values;
+
+	if (!column)
+		return NULL;
+
+	values = csv_read_column(file, column, &rows);
+	if (rows != num_rows) {
+		fprintf(stderr, "column %d has %d rows, expected %d\n",
+			column, rows, num_rows);
+		exit(EXIT_FAILURE);
+	}
+	return values;
+}
+
+static uint64_t ms_to_ns(double ms, int row)
+{
+	if (ms < 0) {
+		fprintf(stderr, "negative time in row %d\n", row + 1);
+		exit(EXIT_FAILURE);
+	}
+	return (uint64_t) (ms * 1000000.0 + 0.5);
+}
+
+#define OPTSTR "e:a:l:r:s:h"
+
+int main(int argc, char** argv)
+{
+	int opt, i, num_jobs;
+	int exec_column = 1;
+	int arrival_column = 0;
+	int cs_column = 0;
+	int resource_column = 0;
+	int suspension_column = 0;
+	const char *csv_file, *trace_file;
+	double *exec_times, *arrival_times, *cs_lengths, *resources;
+	double *suspensions;
+	struct job_trace_record *records;
+	uint32_t flags = 0;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 'e':
+			exec_column = want_positive_int(optarg, "-e");
+			break;
+		case 'a':
+			arrival_column = want_positive_int(optarg, "-a");
+			break;
+		case 'l':
+			cs_column = want_positive_int(optarg, "-l");
+			break;
+		case 'r':
+			resource_column = want_positive_int(optarg, "-r");
+			break;
+		case 's':
+			suspension_column = want_positive_int(optarg, "-s");
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	if (argc - optind != 2)
+		usage("Expected an input and an output file.");
+	if (resource_column && !cs_column)
+		usage("-r requires -l.");
+
+	csv_file   = argv[optind + 0];
+	trace_file = argv[optind + 1];
+
+	exec_times    = csv_read_column(csv_file, exec_column, &num_jobs);
+	if (!num_jobs)
+		usage("The CSV file does not contain any jobs.");
+	arrival_times = read_column(csv_file, arrival_column, num_jobs);
+	cs_lengths    = read_column(csv_file, cs_column, num_jobs);
+	resources     = read_column(csv_file, resource_column, num_jobs);
+	suspensions   = read_column(csv_file, suspension_column, num_jobs);
+
+	if (arrival_times)
+		flags |= JOB_TRACE_HAS_ARRIVALS;
+	if (cs_lengths)
+		flags |= JOB_TRACE_HAS_LOCKS;
+	if (suspensions)
+		flags |= JOB_TRACE_HAS_SUSPENSIONS;
+
+	records = calloc(num_jobs, sizeof(*records));
+	if (!records)
+		bail_out("couldn't allocate memory");
+
+	for (i = 0; i < num_jobs; i++) {
+		records[i].exec_ns = ms_to_ns(exec_times[i], i);
+		records[i].resource_id = -1;
+		if (arrival_times)
+			records[i].inter_arrival_ns =
+				ms_to_ns(arrival_times[i], i);
+		if (cs_lengths) {
+			records[i].cs_length_ns = ms_to_ns(cs_lengths[i], i);
+			if (resources)
+				records[i].resource_id = resources[i] < 0 ?
+					-1 : (int32_t) resources[i];
+			else if (records[i].cs_length_ns)
+				records[i].resource_id = 0;
+		}
+		if (suspensions)
+			records[i].suspension_ns = ms_to_ns(suspensions[i], i);
+	}
+
+	if (job_trace_write(trace_file, records, num_jobs, flags) != 0)
+		bail_out("could not write job trace");
+
+	printf("Wrote %d jobs to %s.\n", num_jobs, trace_file);
+
+	free(records);
+	free(exec_times);
+	free(arrival_times);
+	free(cs_lengths);
+	free(resources);
+	free(suspensions);
+
+	return 0;
+}
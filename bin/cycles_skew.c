@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "litmus.h"
+#include "common.h"
+
+const char *usage_msg =
+	"Usage: cycles_skew [OPTIONS]\n"
+	"\n"
+	"Check whether get_cycles() timestamps taken on different CPUs can be\n"
+	"compared. For every pair of online CPUs, a ping-pong protocol over a\n"
+	"shared cache line bounds the offset between the two cycle counters;\n"
+	"the skew matrix (offset of the column CPU's counter relative to the row\n"
+	"CPU's, in cycles) and the resulting bound for cross-CPU comparisons are\n"
+	"reported. The counter rate of each CPU is also measured against\n"
+	"CLOCK_MONOTONIC_RAW while idle and while busy, to detect counters that\n"
+	"change their rate with the CPU frequency.\n"
+	"\n"
+	"Options:\n"
+	"    -r ROUNDS         ping-pong rounds per CPU pair (default: 1000)\n"
+	"    -i INTERVAL       rate measurement interval in ms (default: 200)\n"
+	"    -t TOLERANCE      rate deviation considered invariant, in ppm\n"
+	"                      (default: 1000)\n"
+	"    -h                show this help message\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+#define CACHE_LINE 64
+
+/* written only by the initiator */
+static struct {
+	volatile long seq;
+} __attribute__((aligned(CACHE_LINE))) ping;
+
+/* written only by the responder */
+static struct {
+	volatile long seq;
+	volatile cycles_t stamp;
+} __attribute__((aligned(CACHE_LINE))) pong;
+
+static int rounds = 1000;
+
+static inline cycles_t read_cycles(void)
+{
+	/* keep the counter read from moving across the flag accesses */
+	__sync_synchronize();
+	return get_cycles();
+}
+
+static void *responder(void *arg)
+{
+	int cpu = *(int *) arg;
+	long k;
+
+	if (be_migrate_thread_to_cpu(gettid(), cpu) != 0)
+		bail_out("could not migrate responder");
+
+	for (k = 1; k <= rounds; k++) {
+		while (ping.seq != k)
+			/* spin */;
+		pong.stamp = read_cycles();
+		__sync_synchronize();
+		pong.seq = k;
+	}
+	return NULL;
+}
+
+/* Bound the offset of the counter of CPU 'to' relative to the counter of
+ * CPU 'from' (which the calling thread must be running on) to [lo, hi]. */
+static void measure_pair(int to, long long *lo, long long *hi)
+{
+	pthread_t thread;
+	cycles_t t0, t1, tb;
+	long k;
+
+	ping.seq = 0;
+	pong.seq = 0;
+	__sync_synchronize();
+	if (pthread_create(&thread, NULL, responder, &to) != 0)
+		bail_out("could not create responder");
+
+	*lo = -(1LL << 62);
+	*hi = 1LL << 62;
+	for (k = 1; k <= rounds; k++) {
+		t0 = read_cycles();
+		ping.seq = k;
+		while (pong.seq != k)
+			/* spin */;
+		t1 = read_cycles();
+		tb = pong.stamp;
+
+		/* the responder read its counter between t0 and t1 */
+		if ((long long) (tb - t1) > *lo)
+			*lo = (long long) (tb - t1);
+		if ((long long) (tb - t0) < *hi)
+			*hi = (long long) (tb - t0);
+	}
+
+	pthread_join(thread, NULL);
+}
+
+static double timespec_diff(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+/* cycles per second over one interval, sleeping or spinning */
+static double measure_rate(double interval, int busy)
+{
+	struct timespec start, now, nap;
+	cycles_t c0, c1;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+	c0 = get_cycles();
+	if (busy) {
+		do {
+			clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+		} while (timespec_diff(&start, &now) < interval);
+	} else {
+		nap.tv_sec = (time_t) interval;
+		nap.tv_nsec = (long) ((interval - nap.tv_sec) * 1e9);
+		nanosleep(&nap, NULL);
+	}
+	c1 = get_cycles();
+	clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+	return (c1 - c0) / timespec_diff(&start, &now);
+}
+
+#define OPTSTR "r:i:t:h"
+
+int main(int argc, char** argv)
+{
+	int opt, i, j, num_cpus, invariant = 1, consistent = 1;
+	double interval = 0.2, tolerance = 1000, idle, busy, dev, rate0 = 0;
+	long long lo, hi, *skew, bound = 0;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 'r':
+			rounds = want_positive_int(optarg, "-r");
+			break;
+		case 'i':
+			interval = want_positive_double(optarg, "-i") / 1000;
+			break;
+		case 't':
+			tolerance = want_non_negative_double(optarg, "-t");
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	num_cpus = num_online_cpus();
+	skew = calloc(num_cpus * num_cpus, sizeof(long long));
+	if (!skew)
+		bail_out("couldn't allocate memory");
+
+	printf("# counter rate (cycles/s), idle vs. busy\n");
+	printf("%4s %16s %16s %10s\n", "cpu", "idle", "busy", "dev(ppm)");
+	for (i = 0; i < num_cpus; i++) {
+		if (be_migrate_to_cpu(i) != 0)
+			bail_out("could not migrate to target CPU");
+		idle = measure_rate(interval, 0);
+		busy = measure_rate(interval, 1);
+		if (!i)
+			rate0 = idle;
+		dev = (busy > idle ? busy - idle : idle - busy) / idle * 1e6;
+		/* all counters should also tick at the same rate */
+		if (dev > tolerance ||
+		    (idle > rate0 ? idle - rate0 : rate0 - idle) / rate0 * 1e6
+		    > tolerance)
+			invariant = 0;
+		printf("%4d %16.0f %16.0f %10.1f\n", i, idle, busy, dev);
+	}
+
+	for (i = 0; i < num_cpus; i++) {
+		if (be_migrate_to_cpu(i) != 0)
+			bail_out("could not migrate to target CPU");
+		for (j = 0; j < num_cpus; j++) {
+			if (i == j)
+				continue;
+			measure_pair(j, &lo, &hi);
+			/* no offset satisfies all rounds: the counters drift
+			 * or are not monotonic across CPUs */
+			if (lo > hi)
+				consistent = 0;
+			skew[i * num_cpus + j] = (lo + hi) / 2;
+			if (-lo > bound)
+				bound = -lo;
+			if (hi > bound)
+				bound = hi;
+		}
+	}
+
+	printf("\n# skew matrix (cycles): counter of column CPU minus "
+	       "counter of row CPU\n");
+	printf("%6s", "");
+	for (j = 0; j < num_cpus; j++)
+		printf(" %10d", j);
+	printf("\n");
+	for (i = 0; i < num_cpus; i++) {
+		printf("%6d", i);
+		for (j = 0; j < num_cpus; j++)
+			printf(" %10lld", skew[i * num_cpus + j]);
+		printf("\n");
+	}
+
+	printf("\n# cross-CPU comparison bound: %lld cycles (%.1f ns)\n",
+	       bound, bound / rate0 * 1e9);
+	printf("# counter rate: %s\n", invariant ?
+	       "invariant" : "NOT invariant (varies across CPUs or with load)");
+	if (!consistent)
+		printf("# offsets inconsistent across rounds: counters drift "
+		       "or are not monotonic across CPUs\n");
+
+	free(skew);
+	return invariant && consistent ? 0 : 1;
+}
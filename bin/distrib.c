@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "distrib.h"
+
+/* Euler-Mascheroni constant, for the mean of the Gumbel distribution */
+#define EULER_GAMMA 0.57721566490153286
+
+static const struct {
+	const char *name;
+	enum distrib_type type;
+	int num_params;
+} families[] = {
+	{"lognormal", DISTRIB_LOGNORMAL, 2},
+	{"weibull",   DISTRIB_WEIBULL,   2},
+	{"bimodal",   DISTRIB_BIMODAL,   5},
+	{"gumbel",    DISTRIB_GUMBEL,    2},
+};
+
+#define NUM_FAMILIES (sizeof(families) / sizeof(families[0]))
+
+int distrib_parse(const char *spec, struct distrib *dist)
+{
+	const char *pos;
+	char *end;
+	size_t len;
+	int fam, n = 0;
+	double *p = dist->param;
+
+	memset(dist, 0, sizeof(*dist));
+
+	len = strcspn(spec, ":");
+	for (fam = 0; fam < NUM_FAMILIES; fam++)
+		if (strlen(families[fam].name) == len &&
+		    strncmp(spec, families[fam].name, len) == 0)
+			break;
+	if (fam == NUM_FAMILIES) {
+		fprintf(stderr, "unknown distribution '%.*s'\n", (int) len, spec);
+		return -1;
+	}
+	dist->type = families[fam].type;
+
+	for (pos = spec + len; *pos == ':' && n < DISTRIB_MAX_PARAMS; n++) {
+		p[n] = strtod(pos + 1, &end);
+		if (end == pos + 1)
+			break;
+		pos = end;
+	}
+	if (*pos != '\0' || n != families[fam].num_params) {
+		fprintf(stderr, "distribution %s expects %d parameters\n",
+			families[fam].name, families[fam].num_params);
+		return -1;
+	}
+
+	switch (dist->type) {
+	case DISTRIB_LOGNORMAL:
+		if (p[0] <= 0 || p[1] < 0)
+			goto invalid;
+		/* convert mean and standard deviation to mu and sigma */
+		p[1] = sqrt(log(1 + (p[1] * p[1]) / (p[0] * p[0])));
+		p[0] = log(p[0]) - p[1] * p[1] / 2;
+		break;
+	case DISTRIB_WEIBULL:
+		if (p[0] <= 0 || p[1] <= 0)
+			goto invalid;
+		break;
+	case DISTRIB_BIMODAL:
+		if (p[0] < 0 || p[0] > 1 || p[2] < 0 || p[4] < 0)
+			goto invalid;
+		break;
+	case DISTRIB_GUMBEL:
+		if (p[1] <= 0)
+			goto invalid;
+		break;
+	}
+
+	return 0;
+
+invalid:
+	fprintf(stderr, "invalid parameters for distribution %s\n",
+		families[fam].name);
+	return -1;
+}
+
+/* uniform in (0, 1), so that logarithms stay finite */
+static double uniform(struct rng *rng)
+{
+	double u;
+
+	do {
+		u = rng_uniform(rng);
+	} while (u == 0);
+	return u;
+}
+
+/* standard normal variate (Box-Muller) */
+static double normal(struct rng *rng)
+{
+	double u1 = uniform(rng), u2 = uniform(rng);
+	return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+double distrib_sample(const struct distrib *dist, struct rng *rng)
+{
+	const double *p = dist->param;
+	double x = 0;
+
+	switch (dist->type) {
+	case DISTRIB_LOGNORMAL:
+		x = exp(p[0] + p[1] * normal(rng));
+		break;
+	case DISTRIB_WEIBULL:
+		x = p[1] * pow(-log(uniform(rng)), 1 / p[0]);
+		break;
+	case DISTRIB_BIMODAL:
+		if (uniform(rng) < p[0])
+			x = p[1] + p[2] * normal(rng);
+		else
+			x = p[3] + p[4] * normal(rng);
+		break;
+	case DISTRIB_GUMBEL:
+		x = p[0] - p[1] * log(-log(uniform(rng)));
+		break;
+	}
+
+	return x > 0 ? x : 0;
+}
+
+double distrib_mean(const struct distrib *dist)
+{
+	const double *p = dist->param;
+
+	switch (dist->type) {
+	case DISTRIB_LOGNORMAL:
+		return exp(p[0] + p[1] * p[1] / 2);
+	case DISTRIB_WEIBULL:
+		return p[1] * tgamma(1 + 1 / p[0]);
+	case DISTRIB_BIMODAL:
+		return p[0] * p[1] + (1 - p[0]) * p[3];
+	case DISTRIB_GUMBEL:
+		return p[0] + p[1] * EULER_GAMMA;
+	}
+	return 0;
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "job_trace.h"
+
+static int trace_error(const char *file, const char *msg)
+{
+	fprintf(stderr, "%s: %s\n", file, msg);
+	return -1;
+}
+
+int job_trace_open(const char *file, struct job_trace *trace)
+{
+	int fd;
+	struct stat st;
+	void *mapped;
+	const struct job_trace_header *hdr;
+
+	memset(trace, 0, sizeof(*trace));
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "%s: cannot open job trace (%m)\n", file);
+		return -1;
+	}
+
+	if (fstat(fd, &st) != 0) {
+		fprintf(stderr, "%s: cannot stat job trace (%m)\n", file);
+		close(fd);
+		return -1;
+	}
+
+	if (st.st_size < sizeof(struct job_trace_header)) {
+		close(fd);
+		return trace_error(file, "too short to be a job trace");
+	}
+
+	/* The records are used in place; nothing is read or copied here. */
+	mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		fprintf(stderr, "%s: cannot map job trace (%m)\n", file);
+		return -1;
+	}
+
+	hdr = mapped;
+	trace->hdr = hdr;
+	trace->map_size = st.st_size;
+
+	if (memcmp(hdr->magic, JOB_TRACE_MAGIC, sizeof(hdr->magic)) != 0) {
+		job_trace_close(trace);
+		return trace_error(file, "not a job trace (bad magic)");
+	}
+	if (hdr->byte_order != JOB_TRACE_BYTE_ORDER) {
+		job_trace_close(trace);
+		return trace_error(file, "job trace has foreign byte order");
+	}
+	if (hdr->version != JOB_TRACE_VERSION ||
+	    hdr->record_size != sizeof(struct job_trace_record)) {
+		job_trace_close(trace);
+		return trace_error(file, "unsupported job trace version");
+	}
+	if (hdr->num_records == 0 ||
+	    hdr->num_records > (st.st_size - sizeof(*hdr)) / hdr->record_size) {
+		job_trace_close(trace);
+		return trace_error(file, "job trace is empty or truncated");
+	}
+
+	trace->begin = (const struct job_trace_record*) (hdr + 1);
+	trace->end   = trace->begin + hdr->num_records;
+	trace->next  = trace->begin;
+
+	return 0;
+}
+
+void job_trace_close(struct job_trace *trace)
+{
+	if (trace->hdr)
+		munmap((void*) trace->hdr, trace->map_size);
+	memset(trace, 0, sizeof(*trace));
+}
+
+uint64_t job_trace_span_ns(const struct job_trace *trace)
+{
+	const struct job_trace_record *rec;
+	uint64_t span = 0;
+
+	for (rec = trace->begin; rec != trace->end; rec++)
+		span += rec->inter_arrival_ns;
+	return span;
+}
+
+int job_trace_write(const char *file, const struct job_trace_record *records,
+		    uint64_t num_records, uint32_t flags)
+{
+	FILE *out;
+	struct job_trace_header hdr;
+	int ok;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, JOB_TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.version     = JOB_TRACE_VERSION;
+	hdr.record_size = sizeof(struct job_trace_record);
+	hdr.byte_order  = JOB_TRACE_BYTE_ORDER;
+	hdr.flags       = flags;
+	hdr.num_records = num_records;
+
+	out = fopen(file, "w");
+	if (!out)
+		return -1;
+
+	ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1 &&
+	     fwrite(records, sizeof(*records), num_records, out) == num_records;
+
+	if (fclose(out) != 0)
+		ok = 0;
+
+	return ok ? 0 : -1;
+}
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "litmus.h"
+#include "common.h"
+
+const char *usage_msg =
+	"Usage: lock_latency [OPTIONS]\n"
+	"\n"
+	"Measure the cost of uncontended FMLP lock and unlock operations, both\n"
+	"through the kernel and with the userspace fast path\n"
+	"(litmus_open_fast_lock()). All times are in cycles; the distribution of\n"
+	"each variant and operation is printed as CSV.\n"
+	"\n"
+	"Options:\n"
+	"    -n SAMPLES        number of lock/unlock pairs per variant (default: 10000)\n"
+	"    -p CPU            partition or cluster to run on (default: 0)\n"
+	"    -L FILE           lock namespace file (default: ./lock_latency-locks)\n"
+	"    -h                show this help message\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static void report(const char *variant, const char *op, cycles_t *samples,
+		   int n)
+{
+	struct sample_stats stats;
+
+	sample_stats(samples, sizeof(cycles_t), n, &stats);
+	printf("%s,%s,", variant, op);
+	print_sample_stats(&stats);
+}
+
+static void measure(const char *variant, int od, cycles_t *lock,
+		    cycles_t *unlock, int n)
+{
+	cycles_t t0, t1, t2;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		t0 = get_cycles();
+		if (litmus_lock(od) != 0)
+			bail_out("litmus_lock() failed");
+		t1 = get_cycles();
+		if (litmus_unlock(od) != 0)
+			bail_out("litmus_unlock() failed");
+		t2 = get_cycles();
+		lock[i] = t1 - t0;
+		unlock[i] = t2 - t1;
+	}
+
+	report(variant, "lock", lock, n);
+	report(variant, "unlock", unlock, n);
+}
+
+#define OPTSTR "n:p:L:h"
+
+int main(int argc, char** argv)
+{
+	int opt, od, fast_od;
+	int samples = 10000, cluster = 0;
+	const char *lock_namespace = "./lock_latency-locks";
+	cycles_t *lock, *unlock;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 'n':
+			samples = want_positive_int(optarg, "-n");
+			break;
+		case 'p':
+			cluster = want_non_negative_int(optarg, "-p");
+			break;
+		case 'L':
+			lock_namespace = optarg;
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	lock = calloc(samples, sizeof(cycles_t));
+	unlock = calloc(samples, sizeof(cycles_t));
+	if (!lock || !unlock)
+		bail_out("couldn't allocate memory");
+
+	if (sporadic_partitioned(s2ns(10), s2ns(10), cluster) != 0)
+		bail_out("could not setup rt task params");
+	if (init_litmus() != 0)
+		bail_out("init_litmus() failed");
+	if (task_mode(LITMUS_RT_TASK) != 0)
+		bail_out("could not become RT task");
+
+	/* distinct resources, so that the variants do not share a lock word */
+	od = litmus_open_lock(FMLP_SEM, 0, lock_namespace, NULL);
+	fast_od = litmus_open_fast_lock(FMLP_SEM, 1, lock_namespace, NULL);
+	if (od < 0 || fast_od < 0)
+		bail_out("could not open locks");
+
+	printf("variant,op,samples,min,p50,p90,p99,max,mean\n");
+	measure("kernel", od, lock, unlock, samples);
+	measure("fast", fast_od, lock, unlock, samples);
+
+	od_close(od);
+	od_close(fast_od);
+
+	task_mode(BACKGROUND_TASK);
+	remove(lock_namespace);
+	free(lock);
+	free(unlock);
+
+	return 0;
+}
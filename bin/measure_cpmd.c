@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "litmus.h"
+#include "common.h"
+#include "rng.h"
+
+const char *usage_msg =
+	"Usage: measure_cpmd [OPTIONS]\n"
+	"\n"
+	"Measure the cache-related preemption and migration delay (CPMD): the\n"
+	"extra time needed to access a working set after losing the cache state\n"
+	"to a preemption or a migration. Each sample accesses the working set\n"
+	"once to warm it up and once more to time a warm access, then either\n"
+	"suspends until the next period (preemption, as a real-time task) or\n"
+	"migrates to another CPU (as a background task), and times a cold\n"
+	"access. Migration targets are classified by the scheduling domains\n"
+	"(domain_to_cpus()) shared with the source CPU: 'domain' if the target\n"
+	"shares a domain with it, 'remote' otherwise. The distributions of the\n"
+	"warm access time and of the CPMD (cold minus warm access time) of\n"
+	"each level are reported in cycles.\n"
+	"\n"
+	"Options:\n"
+	"    -w WSS            working set size in KB (default: 256)\n"
+	"    -n SAMPLES        samples per level and target CPU (default: 1000)\n"
+	"    -c CPU            source CPU (default: 0)\n"
+	"    -m MODE           preempt, migrate, or all (default: all)\n"
+	"    -p PERIOD         period of the preempted task in ms (default: 10)\n"
+	"    -P POLLUTE        while the task is suspended, have a background\n"
+	"                      task on the same CPU scan POLLUTE KB of memory\n"
+	"                      (default: twice the last-level cache; 0 to\n"
+	"                      measure preemptions without interference)\n"
+	"    -W                also write to each accessed cache line\n"
+	"    -s                access the working set sequentially instead of\n"
+	"                      in a random order\n"
+	"    -h                show this help message\n"
+	"\n"
+	"Output columns: level,samples,min,p50,p90,p99,max,mean\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+#define CACHE_LINE 64
+#define LINE_WORDS (CACHE_LINE / sizeof(unsigned long))
+
+static volatile unsigned long *wss;
+static size_t wss_lines;
+static int write_lines = 0;
+
+/* Link the cache lines of the working set into a cycle, in a random order
+ * unless 'sequential' is set, so that hardware prefetching cannot hide the
+ * cache misses. */
+static void build_working_set(size_t size, int sequential)
+{
+	size_t *order, i, j, tmp;
+	struct rng rng;
+
+	wss_lines = size / CACHE_LINE;
+	wss = mmap(NULL, wss_lines * CACHE_LINE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	order = calloc(wss_lines, sizeof(size_t));
+	if (wss == MAP_FAILED || !order)
+		bail_out("couldn't allocate working set");
+
+	for (i = 0; i < wss_lines; i++)
+		order[i] = i;
+	if (!sequential) {
+		rng_seed(&rng, 1, 0);
+		for (i = wss_lines - 1; i > 0; i--) {
+			j = rng_below(&rng, i + 1);
+			tmp = order[i];
+			order[i] = order[j];
+			order[j] = tmp;
+		}
+	}
+	for (i = 0; i < wss_lines; i++)
+		wss[order[i] * LINE_WORDS] =
+			order[(i + 1) % wss_lines] * LINE_WORDS;
+	free(order);
+}
+
+/* Follow the cycle once; returns the elapsed cycles. */
+static cycles_t access_working_set(void)
+{
+	cycles_t start, end;
+	unsigned long next = 0;
+	size_t i;
+
+	start = get_cycles();
+	for (i = 0; i < wss_lines; i++) {
+		if (write_lines)
+			wss[next + 1]++;
+		next = wss[next];
+	}
+	end = get_cycles();
+
+	/* keep the loads */
+	asm("" : : "r"(next));
+	return end - start;
+}
+
+/* background task that keeps evicting the working set from the caches */
+static pid_t start_polluter(int cpu, size_t size)
+{
+	volatile char *mem;
+	size_t i;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		bail_out("fork() failed");
+	if (pid)
+		return pid;
+
+	mem = malloc(size);
+	if (!mem || be_migrate_to_cpu(cpu) != 0)
+		_exit(1);
+	while (1)
+		for (i = 0; i < size; i += CACHE_LINE)
+			mem[i]++;
+}
+
+/* the cold access should not be faster, but clamp noise at zero */
+static cycles_t delay(cycles_t warm, cycles_t cold)
+{
+	return cold > warm ? cold - warm : 0;
+}
+
+/* Returns the number of samples taken. */
+static int measure_preemption(int cpu, lt_t period, int samples,
+			      cycles_t *warm, cycles_t *cpmd)
+{
+	struct rt_task param;
+	unsigned long long domains;
+	int i;
+
+	/* stay on the measured CPU, in the first domain that contains it */
+	if (cpu_to_domains(cpu, &domains) != 0 || !domains ||
+	    be_migrate_to_cpu(cpu) != 0)
+		goto not_rt;
+	init_rt_task_param(&param);
+	param.exec_cost = period;
+	param.period = period;
+	param.cpu = domain_to_first_cpu(__builtin_ctzll(domains));
+	if (set_rt_task_param(gettid(), &param) != 0 ||
+	    init_litmus() != 0 || task_mode(LITMUS_RT_TASK) != 0)
+		goto not_rt;
+
+	for (i = 0; i < samples; i++) {
+		access_working_set();
+		warm[i] = access_working_set();
+		sleep_next_period();
+		cpmd[i] = delay(warm[i], access_working_set());
+	}
+
+	task_mode(BACKGROUND_TASK);
+	return samples;
+
+not_rt:
+	fprintf(stderr, "could not become a real-time task, "
+		"skipping preemptions\n");
+	return 0;
+}
+
+/* Returns the number of samples taken. */
+static int measure_migration(int from, int to, int samples,
+			     cycles_t *warm, cycles_t *cpmd)
+{
+	int i;
+
+	for (i = 0; i < samples; i++) {
+		if (be_migrate_to_cpu(from) != 0)
+			bail_out("could not migrate to source CPU");
+		access_working_set();
+		warm[i] = access_working_set();
+		if (be_migrate_to_cpu(to) != 0)
+			bail_out("could not migrate to target CPU");
+		cpmd[i] = delay(warm[i], access_working_set());
+	}
+	return samples;
+}
+
+/* Does any scheduling domain contain both CPUs? Domain IDs are dense, so
+ * stop at the first one that cannot be read. */
+static int share_domain(int a, int b)
+{
+	unsigned long long mask;
+	int d;
+
+	for (d = 0; domain_to_cpus(d, &mask) == 0; d++)
+		if ((mask >> a & 1) && (mask >> b & 1))
+			return 1;
+	return 0;
+}
+
+static void report(const char *level, cycles_t *samples, int n)
+{
+	struct sample_stats stats;
+
+	if (!n)
+		return;
+	sample_stats(samples, sizeof(cycles_t), n, &stats);
+	printf("%s,", level);
+	print_sample_stats(&stats);
+}
+
+enum level {
+	LEVEL_PREEMPT,
+	LEVEL_DOMAIN,
+	LEVEL_REMOTE,
+	NUM_LEVELS
+};
+
+static const char *level_names[NUM_LEVELS] = {"preempt", "domain", "remote"};
+
+#define OPTSTR "w:n:c:m:p:P:Wsh"
+
+int main(int argc, char** argv)
+{
+	int opt, cpu = 0, samples = 1000, num_cpus, to, lvl, n, sequential = 0;
+	int preempt = 1, migrate = 1, nwarm = 0, ncpmd[NUM_LEVELS] = {0};
+	long pollute = -1;
+	size_t size = 256 * 1024;
+	lt_t period = ms2ns(10);
+	cycles_t *warm, *cpmd[NUM_LEVELS];
+	pid_t polluter = 0;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 'w':
+			size = want_positive_int(optarg, "-w") * 1024UL;
+			break;
+		case 'n':
+			samples = want_positive_int(optarg, "-n");
+			break;
+		case 'c':
+			cpu = want_non_negative_int(optarg, "-c");
+			break;
+		case 'm':
+			if (strcmp(optarg, "preempt") == 0)
+				migrate = 0;
+			else if (strcmp(optarg, "migrate") == 0)
+				preempt = 0;
+			else if (strcmp(optarg, "all") != 0)
+				usage("Unknown mode.");
+			break;
+		case 'p':
+			period = ms2ns(want_positive_double(optarg, "-p"));
+			break;
+		case 'P':
+			pollute = want_non_negative_int(optarg, "-P") * 1024L;
+			break;
+		case 'W':
+			write_lines = 1;
+			break;
+		case 's':
+			sequential = 1;
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	num_cpus = num_online_cpus();
+	if (cpu >= num_cpus)
+		usage("Source CPU is not online.");
+	if (size < 2 * CACHE_LINE)
+		usage("Working set too small.");
+
+	/* without a polluter, a suspension alone may not evict anything */
+	if (pollute < 0) {
+		pollute = 2 * last_level_cache_size();
+		if (!pollute)
+			pollute = 64 << 20;
+	}
+
+	/* every level gets up to one set of samples per target CPU */
+	warm = calloc((size_t) samples * num_cpus, sizeof(cycles_t));
+	for (lvl = 0; lvl < NUM_LEVELS; lvl++)
+		cpmd[lvl] = calloc((size_t) samples * num_cpus,
+				   sizeof(cycles_t));
+	if (!warm || !cpmd[LEVEL_PREEMPT] || !cpmd[LEVEL_DOMAIN] ||
+	    !cpmd[LEVEL_REMOTE])
+		bail_out("couldn't allocate memory");
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+		perror("mlockall");
+	build_working_set(size, sequential);
+
+	if (migrate)
+		for (to = 0; to < num_cpus; to++) {
+			if (to == cpu)
+				continue;
+			lvl = share_domain(cpu, to) ? LEVEL_DOMAIN : LEVEL_REMOTE;
+			n = measure_migration(cpu, to, samples, warm + nwarm,
+					      cpmd[lvl] + ncpmd[lvl]);
+			nwarm += n;
+			ncpmd[lvl] += n;
+		}
+
+	if (preempt) {
+		if (be_migrate_to_cpu(cpu) != 0)
+			bail_out("could not migrate to source CPU");
+		if (pollute)
+			polluter = start_polluter(cpu, pollute);
+		n = measure_preemption(cpu, period, samples, warm + nwarm,
+				       cpmd[LEVEL_PREEMPT]);
+		nwarm += n;
+		ncpmd[LEVEL_PREEMPT] += n;
+		if (polluter) {
+			kill(polluter, SIGKILL);
+			waitpid(polluter, NULL, 0);
+		}
+	}
+
+	printf("level,samples,min,p50,p90,p99,max,mean\n");
+	report("warm", warm, nwarm);
+	for (lvl = 0; lvl < NUM_LEVELS; lvl++)
+		report(level_names[lvl], cpmd[lvl], ncpmd[lvl]);
+
+	munmap((void *) wss, wss_lines * CACHE_LINE);
+	free(warm);
+	for (lvl = 0; lvl < NUM_LEVELS; lvl++)
+		free(cpmd[lvl]);
+	return nwarm ? 0 : 1;
+}
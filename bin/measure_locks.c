@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "litmus.h"
+#include "common.h"
+
+const char *usage_msg =
+	"Usage: measure_locks [OPTIONS]\n"
+	"\n"
+	"Measure the overheads of the LITMUS^RT locking protocols. For each\n"
+	"protocol, one task first measures uncontended lock and unlock\n"
+	"operations; then TASKS real-time tasks, spread across partitions,\n"
+	"repeatedly access a shared resource. Distributions of the lock (including\n"
+	"blocking) and unlock times, and of the blocking time (lock time minus the\n"
+	"uncontended median), are written as CSV, in cycles.\n"
+	"\n"
+	"Options:\n"
+	"    -P PROTO[,PROTO...]  protocols to measure\n"
+	"                         (default: FMLP,SRP,PCP,MPCP,DPCP,DFLP)\n"
+	"    -t TASKS             number of contending tasks (default: number of CPUs)\n"
+	"    -n SAMPLES           lock/unlock pairs per task (default: 1000)\n"
+	"    -L CS-LENGTH         critical section length (default: 10us)\n"
+	"    -g GAP               time between critical sections (default: 50us)\n"
+	"    -s CPU               synchronization processor for DPCP and DFLP (default: 0)\n"
+	"    -N FILE              lock namespace file (default: ./measure_locks-locks)\n"
+	"    -h                   show this help message\n"
+	"\n"
+	"Tasks using local protocols (SRP, PCP) all run on partition 0.\n"
+	"Output columns: protocol,tasks,op,samples,min,p50,p90,p99,max,mean\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+#define DEFAULT_PROTOCOLS "FMLP,SRP,PCP,MPCP,DPCP,DFLP"
+#define MAX_PROTOCOLS 16
+
+static int samples = 1000;
+static lt_t cs_length = us2ns(10);
+static lt_t gap = us2ns(50);
+static int sync_cpu = 0;
+static const char *lock_namespace = "./measure_locks-locks";
+static int num_domains;
+
+static int is_local(int protocol)
+{
+	return protocol == SRP_SEM || protocol == PCP_SEM;
+}
+
+/* what the contending tasks measure */
+struct contention {
+	int protocol;
+	cycles_t *lock, *unlock;
+};
+
+/* Body of one contending task; returns the exit status. */
+static int contend(int idx, void *arg)
+{
+	struct contention *c = arg;
+	int protocol = c->protocol;
+	cycles_t *lock = c->lock + idx * samples;
+	cycles_t *unlock = c->unlock + idx * samples;
+	struct rt_task param;
+	cycles_t t0, t1, t2, t3;
+	int od, i, domain, cpu, config;
+
+	domain = is_local(protocol) ? 0 : idx % num_domains;
+	cpu = domain_to_first_cpu(domain);
+	config = (protocol == DPCP_SEM || protocol == DFLP_SEM) ? sync_cpu : cpu;
+
+	if (be_migrate_to_domain(domain) != 0)
+		return 1;
+	init_rt_task_param(&param);
+	param.exec_cost = s2ns(100);
+	param.period = s2ns(100);
+	param.cpu = cpu;
+	param.priority = LITMUS_HIGHEST_PRIORITY + idx;
+	if (set_rt_task_param(gettid(), &param) != 0 ||
+	    init_litmus() != 0 || task_mode(LITMUS_RT_TASK) != 0)
+		return 1;
+
+	od = litmus_open_lock(protocol, 0, lock_namespace, &config);
+	if (od < 0) {
+		/* still take part in the release, but report failure */
+		wait_for_ts_release();
+		return 2;
+	}
+
+	if (wait_for_ts_release() != 0)
+		return 1;
+
+	for (i = 0; i < samples; i++) {
+		t0 = get_cycles();
+		if (litmus_lock(od) != 0)
+			return 1;
+		t1 = get_cycles();
+		spin_for(cs_length);
+		t2 = get_cycles();
+		if (litmus_unlock(od) != 0)
+			return 1;
+		t3 = get_cycles();
+
+		lock[i] = t1 - t0;
+		unlock[i] = t3 - t2;
+		spin_for(gap);
+	}
+
+	od_close(od);
+	task_mode(BACKGROUND_TASK);
+	return 0;
+}
+
+/* Run num_tasks contending tasks; returns 0 if all succeeded. */
+static int run(int protocol, int num_tasks, cycles_t *lock, cycles_t *unlock)
+{
+	struct contention c = {protocol, lock, unlock};
+
+	return run_released_tasks(num_tasks, 1, ms2ns(10), contend, &c);
+}
+
+static void report(const char *protocol, int tasks, const char *op,
+		   cycles_t *samples, int n)
+{
+	struct sample_stats stats;
+
+	sample_stats(samples, sizeof(cycles_t), n, &stats);
+	printf("%s,%d,%s,", protocol, tasks, op);
+	print_sample_stats(&stats);
+}
+
+#define OPTSTR "P:t:n:L:g:s:N:h"
+
+int main(int argc, char** argv)
+{
+	int opt, i, p, num_protocols = 0, num_tasks = 0, total;
+	int protocols[MAX_PROTOCOLS];
+	char default_protocols[] = DEFAULT_PROTOCOLS;
+	char *list = default_protocols, *name;
+	cycles_t *lock, *unlock, uncontended;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 'P':
+			list = optarg;
+			break;
+		case 't':
+			num_tasks = want_positive_int(optarg, "-t");
+			break;
+		case 'n':
+			samples = want_positive_int(optarg, "-n");
+			break;
+		case 'L':
+			cs_length = us2ns(want_non_negative_double(optarg, "-L"));
+			break;
+		case 'g':
+			gap = us2ns(want_non_negative_double(optarg, "-g"));
+			break;
+		case 's':
+			sync_cpu = want_non_negative_int(optarg, "-s");
+			break;
+		case 'N':
+			lock_namespace = optarg;
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	for (name = strtok(list, ","); name && num_protocols < MAX_PROTOCOLS;
+	     name = strtok(NULL, ",")) {
+		protocols[num_protocols] = lock_protocol_for_name(name);
+		if (protocols[num_protocols] < 0)
+			usage("Unknown locking protocol specified.");
+		num_protocols++;
+	}
+
+	if (!num_tasks)
+		num_tasks = num_online_cpus();
+
+	/* samples are written by the forked tasks */
+	total = num_tasks * samples;
+	lock = mmap(NULL, 2 * total * sizeof(cycles_t), PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (lock == MAP_FAILED)
+		bail_out("could not allocate sample buffers");
+	unlock = lock + total;
+
+	if (init_litmus() != 0)
+		bail_out("init_litmus() failed");
+	num_domains = count_domains();
+	if (!num_domains)
+		bail_out("could not read the scheduling domains");
+
+	printf("protocol,tasks,op,samples,min,p50,p90,p99,max,mean\n");
+	for (p = 0; p < num_protocols; p++) {
+		name = (char *) name_for_lock_protocol(protocols[p]);
+
+		/* overheads without contention */
+		if (run(protocols[p], 1, lock, unlock) != 0) {
+			fprintf(stderr, "%s not supported by the active "
+				"plugin, skipped\n", name);
+			continue;
+		}
+		report(name, 1, "lock", lock, samples);
+		report(name, 1, "unlock", unlock, samples);
+		uncontended = lock[samples / 2];
+
+		if (num_tasks < 2)
+			continue;
+		if (run(protocols[p], num_tasks, lock, unlock) != 0) {
+			fprintf(stderr, "%s: contention run failed\n", name);
+			continue;
+		}
+		report(name, num_tasks, "lock", lock, total);
+		report(name, num_tasks, "unlock", unlock, total);
+		for (i = 0; i < total; i++)
+			lock[i] = lock[i] > uncontended ? lock[i] - uncontended : 0;
+		report(name, num_tasks, "blocking", lock, total);
+		fflush(stdout);
+	}
+
+	munmap(lock, 2 * total * sizeof(cycles_t));
+	remove(lock_namespace);
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "litmus.h"
+#include "internal.h"
+#include "common.h"
+
+const char *usage_msg =
+	"Usage: measure_proc [OPTIONS]\n"
+	"\n"
+	"Measure how many queries per second of a (proc) file are possible by\n"
+	"opening, reading, and closing it each time (read_file()) and by\n"
+	"re-reading a file handle that is kept open (read_file_handle()).\n"
+	"\n"
+	"Options:\n"
+	"    -f FILE           file to query (default: /proc/litmus/stats)\n"
+	"    -d DURATION       measurement time per method in seconds\n"
+	"                      (default: 1)\n"
+	"    -h                show this help message\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+#define BATCH 100
+
+static void report(const char *method, long queries, lt_t elapsed)
+{
+	printf("%-8s %10ld queries %12.0f queries/s %10.1f ns/query\n",
+	       method, queries, queries / ns2s((double) elapsed),
+	       (double) elapsed / queries);
+}
+
+#define OPTSTR "f:d:h"
+
+int main(int argc, char** argv)
+{
+	const char *fname = "/proc/litmus/stats";
+	lt_t duration = s2ns(1), start, now;
+	char buf[4096];
+	long queries;
+	int opt, i, handle;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 'f':
+			fname = optarg;
+			break;
+		case 'd':
+			duration = s2ns(want_positive_double(optarg, "-d"));
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	if (read_file(fname, buf, sizeof(buf)) < 0)
+		bail_out("could not read file");
+
+	queries = 0;
+	start = litmus_clock();
+	do {
+		for (i = 0; i < BATCH; i++)
+			if (read_file(fname, buf, sizeof(buf)) < 0)
+				bail_out("read_file()");
+		queries += BATCH;
+		now = litmus_clock();
+	} while (now - start < duration);
+	report("open", queries, now - start);
+
+	handle = open_file_handle(fname);
+	if (handle < 0)
+		bail_out("open_file_handle()");
+	queries = 0;
+	start = litmus_clock();
+	do {
+		for (i = 0; i < BATCH; i++)
+			if (read_file_handle(handle, buf, sizeof(buf)) < 0)
+				bail_out("read_file_handle()");
+		queries += BATCH;
+		now = litmus_clock();
+	} while (now - start < duration);
+	report("handle", queries, now - start);
+	close_file_handle(handle);
+
+	return 0;
+}
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "litmus.h"
+#include "spinlock.h"
+#include "common.h"
+
+const char *usage_msg =
+	"Usage: measure_spinlocks [OPTIONS]\n"
+	"\n"
+	"Compare the non-preemptive userspace spin locks (FIFO ticket and MCS\n"
+	"queue locks) with FMLP semaphores (litmus_lock()). For each critical\n"
+	"section length, TASKS real-time tasks, one per partition, repeatedly\n"
+	"access a shared resource with each kind of lock. The distributions of\n"
+	"the acquisition (including spinning or blocking) and release times are\n"
+	"written as CSV, in cycles.\n"
+	"\n"
+	"Options:\n"
+	"    -t TASKS             number of contending tasks (default: number of CPUs)\n"
+	"    -n SAMPLES           lock/unlock pairs per task (default: 1000)\n"
+	"    -c CS[,CS...]        critical section lengths in microseconds\n"
+	"                         (default: 0.1,1,10,100)\n"
+	"    -g GAP               time between critical sections (default: 50us)\n"
+	"    -N FILE              FMLP lock namespace file\n"
+	"                         (default: ./measure_spinlocks-locks)\n"
+	"    -h                   show this help message\n"
+	"\n"
+	"Output columns: lock,cs_us,tasks,op,samples,min,p50,p90,p99,max,mean\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+#define DEFAULT_CS_LENGTHS "0.1,1,10,100"
+#define MAX_CS_LENGTHS 16
+
+enum lock_kind {
+	LOCK_TICKET,
+	LOCK_MCS,
+	LOCK_FMLP,
+	NUM_LOCK_KINDS
+};
+
+static const char *lock_names[NUM_LOCK_KINDS] = {"ticket", "mcs", "fmlp"};
+
+static int samples = 1000;
+static lt_t gap = us2ns(50);
+static const char *lock_namespace = "./measure_spinlocks-locks";
+static int num_domains;
+
+/* shared among all tasks */
+static struct litmus_ticket_lock *ticket;
+static struct litmus_mcs_lock *mcs;
+
+static void acquire(enum lock_kind kind, int idx, int od)
+{
+	switch (kind) {
+	case LOCK_TICKET:
+		litmus_ticket_lock(ticket);
+		break;
+	case LOCK_MCS:
+		litmus_mcs_lock(mcs, idx);
+		break;
+	default:
+		if (litmus_lock(od) != 0)
+			_exit(1);
+	}
+}
+
+static void release(enum lock_kind kind, int idx, int od)
+{
+	switch (kind) {
+	case LOCK_TICKET:
+		litmus_ticket_unlock(ticket);
+		break;
+	case LOCK_MCS:
+		litmus_mcs_unlock(mcs, idx);
+		break;
+	default:
+		if (litmus_unlock(od) != 0)
+			_exit(1);
+	}
+}
+
+/* what the contending tasks measure */
+struct contention {
+	enum lock_kind kind;
+	lt_t cs_length;
+	cycles_t *lock, *unlock;
+};
+
+/* Body of one contending task; returns the exit status. */
+static int contend(int idx, void *arg)
+{
+	struct contention *c = arg;
+	enum lock_kind kind = c->kind;
+	cycles_t *lock = c->lock + idx * samples;
+	cycles_t *unlock = c->unlock + idx * samples;
+	struct rt_task param;
+	cycles_t t0, t1, t2, t3;
+	int od = -1, i, domain = idx % num_domains;
+
+	if (be_migrate_to_domain(domain) != 0)
+		return 1;
+	init_rt_task_param(&param);
+	param.exec_cost = s2ns(100);
+	param.period = s2ns(100);
+	param.cpu = domain_to_first_cpu(domain);
+	param.priority = LITMUS_HIGHEST_PRIORITY + idx;
+	if (set_rt_task_param(gettid(), &param) != 0 ||
+	    init_litmus() != 0 || task_mode(LITMUS_RT_TASK) != 0)
+		return 1;
+
+	if (kind == LOCK_FMLP) {
+		od = litmus_open_lock(FMLP_SEM, 0, lock_namespace, NULL);
+		if (od < 0) {
+			/* still take part in the release, but report failure */
+			wait_for_ts_release();
+			return 2;
+		}
+	}
+
+	if (wait_for_ts_release() != 0)
+		return 1;
+
+	for (i = 0; i < samples; i++) {
+		t0 = get_cycles();
+		acquire(kind, idx, od);
+		t1 = get_cycles();
+		spin_for(c->cs_length);
+		t2 = get_cycles();
+		release(kind, idx, od);
+		t3 = get_cycles();
+
+		lock[i] = t1 - t0;
+		unlock[i] = t3 - t2;
+		spin_for(gap);
+	}
+
+	if (od >= 0)
+		od_close(od);
+	task_mode(BACKGROUND_TASK);
+	return 0;
+}
+
+/* Run num_tasks contending tasks; returns 0 if all succeeded. */
+static int run(enum lock_kind kind, lt_t cs_length, int num_tasks,
+	       cycles_t *lock, cycles_t *unlock)
+{
+	struct contention c = {kind, cs_length, lock, unlock};
+
+	litmus_ticket_init(ticket);
+	litmus_mcs_init(mcs, num_tasks);
+
+	return run_released_tasks(num_tasks, 1, ms2ns(10), contend, &c);
+}
+
+static void report(const char *name, double cs_us, int tasks, const char *op,
+		   cycles_t *samples, int n)
+{
+	struct sample_stats stats;
+
+	sample_stats(samples, sizeof(cycles_t), n, &stats);
+	printf("%s,%g,%d,%s,", name, cs_us, tasks, op);
+	print_sample_stats(&stats);
+}
+
+#define OPTSTR "t:n:c:g:N:h"
+
+int main(int argc, char** argv)
+{
+	int opt, c, k, num_cs = 0, num_tasks = 0, total;
+	double cs_us[MAX_CS_LENGTHS];
+	char default_cs[] = DEFAULT_CS_LENGTHS;
+	char *list = default_cs, *item;
+	cycles_t *lock, *unlock;
+	size_t shared_size;
+	char *shared;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 't':
+			num_tasks = want_positive_int(optarg, "-t");
+			break;
+		case 'n':
+			samples = want_positive_int(optarg, "-n");
+			break;
+		case 'c':
+			list = optarg;
+			break;
+		case 'g':
+			gap = us2ns(want_non_negative_double(optarg, "-g"));
+			break;
+		case 'N':
+			lock_namespace = optarg;
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	for (item = strtok(list, ","); item && num_cs < MAX_CS_LENGTHS;
+	     item = strtok(NULL, ","))
+		cs_us[num_cs++] = want_non_negative_double(item, "-c");
+
+	if (!num_tasks)
+		num_tasks = num_online_cpus();
+
+	/* locks and samples are shared with the forked tasks */
+	total = num_tasks * samples;
+	shared_size = sizeof(struct litmus_ticket_lock) +
+		litmus_mcs_size(num_tasks) + 2 * total * sizeof(cycles_t);
+	shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		bail_out("could not allocate shared memory");
+	ticket = (struct litmus_ticket_lock *) shared;
+	mcs = (struct litmus_mcs_lock *) (ticket + 1);
+	lock = (cycles_t *) ((char *) mcs + litmus_mcs_size(num_tasks));
+	unlock = lock + total;
+
+	if (init_litmus() != 0)
+		bail_out("init_litmus() failed");
+	num_domains = count_domains();
+	if (!num_domains)
+		bail_out("could not read the scheduling domains");
+
+	printf("lock,cs_us,tasks,op,samples,min,p50,p90,p99,max,mean\n");
+	for (c = 0; c < num_cs; c++)
+		for (k = 0; k < NUM_LOCK_KINDS; k++) {
+			if (run(k, us2ns(cs_us[c]), num_tasks, lock, unlock)) {
+				fprintf(stderr, "%s with %gus critical sections "
+					"failed, skipped\n", lock_names[k],
+					cs_us[c]);
+				continue;
+			}
+			report(lock_names[k], cs_us[c], num_tasks, "lock",
+			       lock, total);
+			report(lock_names[k], cs_us[c], num_tasks, "unlock",
+			       unlock, total);
+			fflush(stdout);
+		}
+
+	munmap(shared, shared_size);
+	remove(lock_namespace);
+
+	return 0;
+}
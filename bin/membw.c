@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include <pthread.h>
+
+#include "litmus.h"
+#include "common.h"
+
+const char *usage_msg =
+	"Usage: membw [OPTIONS]\n"
+	"\n"
+	"Generate cache and memory interference from several best-effort threads,\n"
+	"each pinned to a CPU and throttled to a target bandwidth by a token\n"
+	"bucket. The bandwidth achieved by each thread is reported periodically.\n"
+	"\n"
+	"Options:\n"
+	"    -t THREADS        number of threads (default: one per online CPU)\n"
+	"    -c CPU[,CPU...]   CPUs to pin the threads to, assigned round-robin\n"
+	"                      (default: thread i runs on CPU i)\n"
+	"    -b MBPS           target bandwidth per thread in MB/s (default: unlimited)\n"
+	"    -w PERCENT        percentage of accesses that are writes (default: 0)\n"
+	"    -l LEVEL          size the working set to hit in cache level LEVEL\n"
+	"                      (1, 2, 3, ...) or to miss all caches ('mem', default)\n"
+	"    -s KB             working set size per thread (overrides -l)\n"
+	"    -i MS             reporting interval (default: 1000ms)\n"
+	"    -d SECONDS        stop after SECONDS (default: run until interrupted)\n"
+	"    -h                show this help message\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/* granularity at which threads acquire tokens */
+#define CHUNK_SIZE 4096
+/* token bucket depth, in seconds worth of bandwidth */
+#define BUCKET_DEPTH 0.001
+#define MAX_CPUS 1024
+
+struct thread_ctx {
+	pthread_t thread;
+	int id;
+	int cpu;
+	char *buf;
+	size_t size;
+	/* written only by the thread itself */
+	volatile unsigned long long bytes;
+};
+
+static volatile int stop = 0;
+static volatile int ready = 0; /* threads that finished their setup */
+static double bytes_per_sec;  /* per thread, 0 = unlimited */
+static int write_pct;
+static int line_size = 64;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1E-9;
+}
+
+static void sleep_for(double seconds)
+{
+	struct timespec ts;
+	ts.tv_sec  = (time_t) seconds;
+	ts.tv_nsec = (seconds - ts.tv_sec) * 1E9;
+	nanosleep(&ts, NULL);
+}
+
+/* Touch one cache line per line_size bytes of the chunk; write_pct out of
+ * every hundred accesses are writes, spread evenly over the chunk. */
+static long touch_chunk(char *chunk, int *mix)
+{
+	long sum = 0;
+	int off;
+
+	for (off = 0; off < CHUNK_SIZE; off += line_size) {
+		*mix += write_pct;
+		if (*mix >= 100) {
+			*mix -= 100;
+			chunk[off]++;
+		} else
+			sum += chunk[off];
+	}
+	return sum;
+}
+
+static void* interfere(void *arg)
+{
+	struct thread_ctx *ctx = arg;
+	double depth, tokens, last, t;
+	size_t pos = 0;
+	int mix = 0;
+	long sum = 0;
+
+	if (be_migrate_to_cpu(ctx->cpu) != 0) {
+		fprintf(stderr, "thread %d: could not migrate to CPU %d\n",
+			ctx->id, ctx->cpu);
+		__sync_fetch_and_add(&ready, 1);
+		return NULL;
+	}
+
+	/* fault in the working set on the CPU that uses it */
+	memset(ctx->buf, 1, ctx->size);
+	__sync_fetch_and_add(&ready, 1);
+
+	depth = bytes_per_sec * BUCKET_DEPTH;
+	if (depth < CHUNK_SIZE)
+		depth = CHUNK_SIZE;
+	tokens = depth;
+	last = now();
+
+	while (!stop) {
+		if (bytes_per_sec > 0) {
+			/* refill the bucket */
+			t = now();
+			tokens += (t - last) * bytes_per_sec;
+			last = t;
+			if (tokens > depth)
+				tokens = depth;
+			if (tokens < CHUNK_SIZE) {
+				sleep_for((CHUNK_SIZE - tokens) / bytes_per_sec);
+				continue;
+			}
+			tokens -= CHUNK_SIZE;
+		}
+
+		sum += touch_chunk(ctx->buf + pos, &mix);
+		pos += CHUNK_SIZE;
+		if (pos + CHUNK_SIZE > ctx->size)
+			pos = 0;
+		ctx->bytes += CHUNK_SIZE;
+	}
+
+	return (void*) sum;
+}
+
+static int read_line_size(void)
+{
+	FILE *f = fopen("/sys/devices/system/cpu/cpu0/cache/index0/"
+			"coherency_line_size", "r");
+	int size = 0;
+
+	if (f) {
+		if (fscanf(f, "%d", &size) != 1)
+			size = 0;
+		fclose(f);
+	}
+	return size > 0 && size <= CHUNK_SIZE ? size : 64;
+}
+
+/* A working set of half the cache at the requested level fits into it, but
+ * (usually) not into the level below. To miss all caches, use four times
+ * the size of the largest cache. */
+static size_t working_set_for_level(int level)
+{
+	long size;
+
+	if (level > 0) {
+		size = cache_size(level);
+		if (!size)
+			bail_out("cache level not reported by the kernel");
+		return size / 2;
+	}
+
+	size = last_level_cache_size();
+	return size ? 4 * size : 64 << 20;
+}
+
+static void handle_signal(int sig)
+{
+	stop = 1;
+}
+
+#define OPTSTR "t:c:b:w:l:s:i:d:h"
+
+int main(int argc, char** argv)
+{
+	int opt, i, num_threads = 0, num_cpus = 0, level = 0;
+	int cpus[MAX_CPUS];
+	double interval_ms = 1000, duration = 0;
+	double start, last, t, mbps, total;
+	size_t size = 0;
+	unsigned long long *prev;
+	struct thread_ctx *ctx;
+	char *cpu_list = NULL, *tok;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 't':
+			num_threads = want_positive_int(optarg, "-t");
+			break;
+		case 'c':
+			cpu_list = optarg;
+			break;
+		case 'b':
+			bytes_per_sec = want_positive_double(optarg, "-b") * 1E6;
+			break;
+		case 'w':
+			write_pct = want_non_negative_int(optarg, "-w");
+			if (write_pct > 100)
+				usage("-w: PERCENT must not exceed 100");
+			break;
+		case 'l':
+			if (strcmp(optarg, "mem") == 0)
+				level = 0;
+			else
+				level = want_positive_int(optarg, "-l");
+			break;
+		case 's':
+			size = (size_t) want_positive_int(optarg, "-s") * 1024;
+			break;
+		case 'i':
+			interval_ms = want_positive_double(optarg, "-i");
+			break;
+		case 'd':
+			duration = want_positive_double(optarg, "-d");
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	if (cpu_list) {
+		for (tok = strtok(cpu_list, ","); tok && num_cpus < MAX_CPUS;
+		     tok = strtok(NULL, ","))
+			cpus[num_cpus++] = want_non_negative_int(tok, "-c");
+	} else {
+		num_cpus = num_online_cpus();
+		if (num_cpus > MAX_CPUS)
+			num_cpus = MAX_CPUS;
+		for (i = 0; i < num_cpus; i++)
+			cpus[i] = i;
+	}
+	if (!num_threads)
+		num_threads = num_cpus;
+
+	line_size = read_line_size();
+	if (!size)
+		size = working_set_for_level(level);
+	size = (size + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE;
+
+	ctx = calloc(num_threads, sizeof(*ctx));
+	prev = calloc(num_threads, sizeof(*prev));
+	if (!ctx || !prev)
+		bail_out("couldn't allocate memory");
+
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	printf("%d threads, %zu KB working set each, %d%% writes, "
+	       "target %s", num_threads, size / 1024, write_pct,
+	       bytes_per_sec > 0 ? "" : "unlimited\n");
+	if (bytes_per_sec > 0)
+		printf("%.1f MB/s per thread\n", bytes_per_sec / 1E6);
+
+	for (i = 0; i < num_threads; i++) {
+		ctx[i].id = i;
+		ctx[i].cpu = cpus[i % num_cpus];
+		ctx[i].size = size;
+		ctx[i].buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ctx[i].buf == MAP_FAILED)
+			bail_out("could not allocate working set");
+		if (pthread_create(&ctx[i].thread, NULL, interfere, ctx + i))
+			bail_out("could not create thread");
+	}
+
+	/* start reporting once all working sets are populated */
+	while (ready < num_threads && !stop)
+		sleep_for(0.001);
+
+	start = last = now();
+	while (!stop) {
+		sleep_for(interval_ms * 0.001);
+		t = now();
+		total = 0;
+		printf("%9.3fs", t - start);
+		for (i = 0; i < num_threads; i++) {
+			mbps = (ctx[i].bytes - prev[i]) / (t - last) / 1E6;
+			prev[i] = ctx[i].bytes;
+			total += mbps;
+			printf(" %d@%d:%.1f", i, ctx[i].cpu, mbps);
+		}
+		printf("  total: %.1f MB/s\n", total);
+		fflush(stdout);
+		last = t;
+
+		if (duration && t - start >= duration)
+			stop = 1;
+	}
+
+	for (i = 0; i < num_threads; i++) {
+		pthread_join(ctx[i].thread, NULL);
+		munmap(ctx[i].buf, size);
+	}
+	free(ctx);
+	free(prev);
+
+	return 0;
+}
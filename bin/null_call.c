@@ -1,10 +1,43 @@
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <time.h>
 #include <math.h>
 
 #include "litmus.h"
+#include "common.h"
+
+const char *usage_msg =
+	"Usage: measure_syscall [OPTIONS] [DELAY]\n"
+	"\n"
+	"Measure the cost of a LITMUS^RT system call (null_call()). Without -n,\n"
+	"one raw sample (pre, in kernel, post, entry, exit, total, in cycles) is\n"
+	"printed whenever the enter key is pressed, or every DELAY seconds.\n"
+	"\n"
+	"With -n, SAMPLES samples of null_call(), getpid(), and a raw syscall()\n"
+	"are taken after a warm-up, and the distributions of the entry, exit,\n"
+	"and total times (in cycles) are reported.\n"
+	"\n"
+	"Options:\n"
+	"    -n SAMPLES        batch mode: number of samples per call\n"
+	"    -p CPU            pin to CPU\n"
+	"    -w WARMUP         calls before sampling in batch mode (default: 1000)\n"
+	"    -r RATE           take samples at RATE per second instead of\n"
+	"                      back-to-back\n"
+	"    -f csv|json       batch output format (default: csv)\n"
+	"    -h                show this help message\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
 
 static void time_null_call(void)
 {
@@ -16,7 +49,7 @@ static void time_null_call(void)
 	t2 = get_cycles();
 	if (ret != 0)
 		perror("null_call");
-	printf("%10" CYCLES_FMT ", " 
+	printf("%10" CYCLES_FMT ", "
 	       "%10" CYCLES_FMT ", "
 	       "%10" CYCLES_FMT ", "
 	       "%10" CYCLES_FMT ", "
@@ -34,16 +67,187 @@ static struct timespec sec2timespec(double seconds)
 	return tspec;
 }
 
+/* calls compared in batch mode */
+enum call {
+	CALL_NULL_CALL,
+	CALL_GETPID,
+	CALL_SYSCALL,
+	NUM_CALLS
+};
+
+static const char *call_names[NUM_CALLS] = {"null_call", "getpid", "syscall"};
+
+/* Take one sample; only null_call() tells when it was in the kernel. */
+static int sample(enum call call, cycles_t *entry, cycles_t *leave,
+		  cycles_t *total)
+{
+	cycles_t t0, t1 = 0, t2;
+	int ret = 0;
+
+	switch (call) {
+	case CALL_NULL_CALL:
+		t0 = get_cycles();
+		ret = null_call(&t1);
+		t2 = get_cycles();
+		break;
+	case CALL_GETPID:
+		t0 = get_cycles();
+		getpid();
+		t2 = get_cycles();
+		break;
+	default:
+		t0 = get_cycles();
+		syscall(SYS_getpid);
+		t2 = get_cycles();
+		break;
+	}
+
+	if (t1) {
+		*entry = t1 - t0;
+		*leave = t2 - t1;
+	}
+	*total = t2 - t0;
+	return ret;
+}
+
+static int json_records;
+
+static void report(int json, const char *call, const char *op,
+		   cycles_t *samples, int n)
+{
+	struct sample_stats st;
+
+	sample_stats(samples, sizeof(cycles_t), n, &st);
+
+	if (json)
+		printf("%s\n  {\"call\": \"%s\", \"op\": \"%s\", "
+		       "\"samples\": %d, \"min\": %llu, \"p50\": %llu, "
+		       "\"p90\": %llu, \"p99\": %llu, \"p999\": %llu, "
+		       "\"max\": %llu, \"mean\": %.1f}",
+		       json_records++ ? "," : "", call, op, st.n, st.min,
+		       st.p50, st.p90, st.p99, st.p999, st.max, st.mean);
+	else
+		printf("%s,%s,%d,%llu,%llu,%llu,%llu,%llu,%llu,%.1f\n",
+		       call, op, st.n, st.min, st.p50, st.p90, st.p99,
+		       st.p999, st.max, st.mean);
+}
+
+static void batch(int samples, int warmup, double rate, int json)
+{
+	cycles_t *entry, *leave, *total;
+	struct timespec next;
+	long interval = rate > 0 ? (long) (1000000000 / rate) : 0;
+	int c, i;
+
+	/* fault in the sample buffers before measuring */
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+		perror("mlockall");
+	entry = calloc(samples, sizeof(cycles_t));
+	leave = calloc(samples, sizeof(cycles_t));
+	total = calloc(samples, sizeof(cycles_t));
+	if (!entry || !leave || !total)
+		bail_out("couldn't allocate memory");
+	memset(entry, 0, samples * sizeof(cycles_t));
+	memset(leave, 0, samples * sizeof(cycles_t));
+	memset(total, 0, samples * sizeof(cycles_t));
+
+	if (json)
+		printf("[");
+	else
+		printf("call,op,samples,min,p50,p90,p99,p999,max,mean\n");
+
+	for (c = 0; c < NUM_CALLS; c++) {
+		if (sample(c, entry, leave, total) != 0) {
+			fprintf(stderr, "%s failed, skipped: %m\n",
+				call_names[c]);
+			continue;
+		}
+		for (i = 0; i < warmup; i++)
+			sample(c, entry, leave, total);
+
+		clock_gettime(CLOCK_MONOTONIC, &next);
+		for (i = 0; i < samples; i++) {
+			if (interval) {
+				next.tv_nsec += interval;
+				while (next.tv_nsec >= 1000000000) {
+					next.tv_nsec -= 1000000000;
+					next.tv_sec++;
+				}
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+						&next, NULL);
+			}
+			sample(c, entry + i, leave + i, total + i);
+		}
+
+		if (c == CALL_NULL_CALL) {
+			report(json, call_names[c], "entry", entry, samples);
+			report(json, call_names[c], "exit", leave, samples);
+		}
+		report(json, call_names[c], "total", total, samples);
+	}
+
+	if (json)
+		printf("\n]\n");
+
+	free(entry);
+	free(leave);
+	free(total);
+}
+
+#define OPTSTR "n:p:w:r:f:h"
+
 int main(int argc, char **argv)
 {
-	double delay;
+	double delay, rate = 0;
 	struct timespec sleep_time;
-	
-	if (argc == 2) {
-		delay = atof(argv[1]);
+	int opt, samples = 0, warmup = 1000, cpu = -1, json = 0;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 'n':
+			samples = want_positive_int(optarg, "-n");
+			break;
+		case 'p':
+			cpu = want_non_negative_int(optarg, "-p");
+			break;
+		case 'w':
+			warmup = want_non_negative_int(optarg, "-w");
+			break;
+		case 'r':
+			rate = want_positive_double(optarg, "-r");
+			break;
+		case 'f':
+			if (strcmp(optarg, "json") == 0)
+				json = 1;
+			else if (strcmp(optarg, "csv") != 0)
+				usage("Unknown output format.");
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	if (cpu >= 0 && be_migrate_to_cpu(cpu) != 0)
+		bail_out("could not migrate to target CPU");
+
+	if (samples) {
+		batch(samples, warmup, rate, json);
+		return 0;
+	}
+
+	if (argc - optind == 1) {
+		delay = atof(argv[optind]);
 		sleep_time = sec2timespec(delay);
 		if (delay <= 0.0)
-			fprintf(stderr, "Invalid time spec: %s\n", argv[1]);
+			fprintf(stderr, "Invalid time spec: %s\n", argv[optind]);
 		fprintf(stderr, "Measuring syscall overhead every "
 			"%lus and %luns.\n",
 			(unsigned long) sleep_time.tv_sec,
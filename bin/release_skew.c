@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "litmus.h"
+#include "common.h"
+
+const char *usage_msg =
+	"Usage: release_skew [OPTIONS]\n"
+	"\n"
+	"Measure how simultaneously synchronously released tasks start. One\n"
+	"real-time task per CPU waits for a synchronous release (release_ts());\n"
+	"after each release, every task timestamps its first instruction and\n"
+	"compares it to the programmed release time in its control page. The\n"
+	"distributions of the per-CPU release latency and of the skew between\n"
+	"the first and the last task to start (both in ns) are reported.\n"
+	"\n"
+	"Options:\n"
+	"    -r ROUNDS         number of releases (default: 1000)\n"
+	"    -d DELAY          release delay after the last task is waiting,\n"
+	"                      in ms (default: 1)\n"
+	"    -h                show this help message\n"
+	"\n"
+	"Output columns: cpu,samples,min,p50,p90,p99,max,mean\n"
+	"(cpu 'skew' is the inter-CPU skew of each round)\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static int rounds = 1000;
+
+/* Body of the waiter on one CPU; returns the exit status. */
+static int waiter(int cpu, void *arg)
+{
+	lt_t *latency = (lt_t *) arg + cpu * rounds;
+	struct control_page *cp;
+	struct rt_task param;
+	unsigned long long domains;
+	lt_t now;
+	int r;
+
+	/* run on this CPU, as part of (the first of) its domains */
+	if (cpu_to_domains(cpu, &domains) != 0 || !domains ||
+	    be_migrate_to_cpu(cpu) != 0)
+		return 1;
+	init_rt_task_param(&param);
+	param.exec_cost = s2ns(100);
+	param.period = s2ns(100);
+	param.cpu = domain_to_first_cpu(__builtin_ctzll(domains));
+	if (set_rt_task_param(gettid(), &param) != 0 ||
+	    init_litmus() != 0 || task_mode(LITMUS_RT_TASK) != 0)
+		return 1;
+	cp = get_ctrl_page();
+	if (!cp)
+		return 1;
+
+	for (r = 0; r < rounds; r++) {
+		if (wait_for_ts_release() != 0)
+			return 1;
+		now = litmus_clock();
+		latency[r] = now > cp->release ? now - cp->release : 0;
+	}
+
+	task_mode(BACKGROUND_TASK);
+	return 0;
+}
+
+static void report(const char *cpu, lt_t *samples, int n)
+{
+	struct sample_stats stats;
+
+	sample_stats(samples, sizeof(lt_t), n, &stats);
+	printf("%s,", cpu);
+	print_sample_stats(&stats);
+}
+
+#define OPTSTR "r:d:h"
+
+int main(int argc, char** argv)
+{
+	int opt, i, r, num_cpus;
+	lt_t delay = ms2ns(1), *latency, *skew, lo, hi;
+	char name[16];
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 'r':
+			rounds = want_positive_int(optarg, "-r");
+			break;
+		case 'd':
+			delay = ms2ns(want_non_negative_double(optarg, "-d"));
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	num_cpus = num_online_cpus();
+
+	/* latencies are written by the forked waiters, one row per CPU */
+	latency = mmap(NULL, num_cpus * rounds * sizeof(lt_t),
+		       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	skew = calloc(rounds, sizeof(lt_t));
+	if (latency == MAP_FAILED || !skew)
+		bail_out("couldn't allocate memory");
+
+	if (run_released_tasks(num_cpus, rounds, delay, waiter, latency)) {
+		fprintf(stderr, "release_skew: some waiters failed\n");
+		return 1;
+	}
+
+	for (r = 0; r < rounds; r++) {
+		lo = hi = latency[r];
+		for (i = 1; i < num_cpus; i++) {
+			if (latency[i * rounds + r] < lo)
+				lo = latency[i * rounds + r];
+			if (latency[i * rounds + r] > hi)
+				hi = latency[i * rounds + r];
+		}
+		skew[r] = hi - lo;
+	}
+
+	printf("cpu,samples,min,p50,p90,p99,max,mean\n");
+	for (i = 0; i < num_cpus; i++) {
+		snprintf(name, sizeof(name), "%d", i);
+		report(name, latency + i * rounds, rounds);
+	}
+	report("skew", skew, rounds);
+
+	munmap(latency, num_cpus * rounds * sizeof(lt_t));
+	free(skew);
+	return 0;
+}
@@ -10,10 +10,15 @@
 #include "litmus.h"
 #include "internal.h"
 
-#define OPTSTR "d:wf:Wq:"
+#define OPTSTR "d:wf:Wq:t:"
 
 #define LITMUS_STATS_FILE "/proc/litmus/stats"
 
+/* polling interval while waiting for tasks, doubled up to the maximum
+ * while nothing changes */
+#define MIN_POLL_INTERVAL us2ns(100)
+#define MAX_POLL_INTERVAL ms2ns(1)
+
 void usage(char *error) {
 	fprintf(stderr,
 		"%s\n"
@@ -27,22 +32,39 @@ void usage(char *error) {
 		"             (as determined by /proc/litmus/stats\n"
 		"         -f  <#tasks> wait for #tasks (default: 0)\n"
 		"         -W  just wait, don't actually release tasks\n"
+		"         -t  <timeout in ms> give up waiting after this long\n"
+		"             (default: wait forever)\n"
 		"\n",
 		error);
 	exit(1);
 }
 
-void wait_until_ready(int expected)
+/* Returns 0 once the tasks are ready, -1 on timeout (if non-zero). */
+int wait_until_ready(int expected, lt_t timeout)
 {
-	int ready = 0, all = 0;
-	int loops = 0;
+	int ready = 0, all = 0, last_ready = -1;
+	lt_t start = litmus_clock(), interval = MIN_POLL_INTERVAL;
 
-	do {
-		if (loops++ > 0)
-			sleep(1);
+	while (1) {
+		/* cheap enough to poll: the stats file is kept open */
 		if (!read_litmus_stats(&ready, &all))
-			perror("read_litmus_stats");
-	} while (expected > ready || (!expected && ready < all));
+			bail_out("could not read " LITMUS_STATS_FILE);
+		if (expected ? ready >= expected : ready >= all)
+			return 0;
+
+		if (timeout && litmus_clock() - start >= timeout)
+			return -1;
+
+		/* poll quickly again while tasks keep arriving */
+		if (ready != last_ready)
+			interval = MIN_POLL_INTERVAL;
+		else if (interval * 2 < MAX_POLL_INTERVAL)
+			interval *= 2;
+		else
+			interval = MAX_POLL_INTERVAL;
+		last_ready = ready;
+		lt_sleep(interval);
+	}
 }
 
 int main(int argc, char** argv)
@@ -54,6 +76,7 @@ int main(int argc, char** argv)
 	int wait = 0;
 	int expected = 0;
 	int exit_after_wait = 0;
+	lt_t timeout = 0;
 	int opt;
 
 	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
@@ -74,6 +97,9 @@ int main(int argc, char** argv)
 			wait = 1;
 			expected = want_non_negative_int(optarg, "-f");
 			break;
+		case 't':
+			timeout = ms2ns(want_positive_double(optarg, "-t"));
+			break;
 		case ':':
 			usage("Argument missing.");
 			break;
@@ -84,8 +110,11 @@ int main(int argc, char** argv)
 		}
 	}
 
-	if (wait)
-		wait_until_ready(expected);
+	if (wait && wait_until_ready(expected, timeout) != 0) {
+		fprintf(stderr, "Timed out waiting for tasks to become "
+			"ready.\n");
+		exit(2);
+	}
 
 	if (exit_after_wait)
 		exit(0);
@@ -11,14 +11,25 @@
 #include <inttypes.h>
 #include <sys/mman.h>
 #include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <getopt.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "litmus.h"
 #include "common.h"
+#include "job_trace.h"
+#include "calibration.h"
+#include "cs_spec.h"
+#include "distrib.h"
+#include "rng.h"
 
 const char *usage_msg =
 	"Usage: (1) rtspin OPTIONS WCET PERIOD DURATION\n"
 	"       (2) rtspin -S [INPUT] WCET PERIOD DURATION\n"
 	"       (3) rtspin OPTIONS -C FILE:COLUMN WCET PERIOD [DURATION]\n"
+	"           rtspin OPTIONS -F TRACE WCET PERIOD [DURATION]\n"
 	"       (4) rtspin -l [-a CYCLES]\n"
 	"       (5) rtspin -B -m FOOTPRINT\n"
 	"       (6) rtspin -a 0\n"
@@ -32,7 +43,8 @@ const char *usage_msg =
 	"       (4) Run calibration loop (how accurately are target\n"
 	"           runtimes met?)\n"
 	"       (5) Run background, non-real-time cache-thrashing loop.\n"
-	"       (6) Run 1 ms workload calibration (estimate cycles for 1ms, 10ms, 100ms workload)\n"
+	"       (6) Run workload calibration (fit a linear cost model of the workload\n"
+	"           loop to repeated CPU-time measurements and report it)\n"
 	"\n"
 	"Required arguments:\n"
 	"    WCET, PERIOD      reservation parameters (in ms)\n"
@@ -40,13 +52,18 @@ const char *usage_msg =
 	"\n"
 	"Options:\n"
 	"    -a CYCLES         number of cycles for 1ms of workload loop chosen after calibration;\n "
-	"                      pass '0' to run the calibration loop\n"
+	"                      pass '0' to run the calibration loop and update the\n"
+	"                      calibration cache\n"
 	"    -B                run non-real-time background loop\n"
 	"    -c be|srt|hrt     task class (best-effort, soft real-time, hard real-time)\n"
 	"    -d DEADLINE       relative deadline, equal to the period by default (in ms)\n"
 	"    -e                turn on budget enforcement (off by default)\n"
 	"    -h                show this help message\n"
-	"    -i                report interrupts (implies -v)\n"
+	"    -i                report interrupts per job (implies -v) and their\n"
+	"                      interference at exit\n"
+	"    -K FILE           use the cached calibration in FILE, if valid; with -a 0,\n"
+	"                      the cache to update ('none' to disable; default:\n"
+	"                      $RTSPIN_CALIBRATION_CACHE or ~/.cache/rtspin-calibration)\n"
 	"    -l                run calibration loop and report error\n"
 	"    -m FOOTPRINT      specify number of data pages to access\n"
 	"    -o OFFSET         offset (also known as phase), zero by default (in ms)\n"
@@ -57,6 +74,14 @@ const char *usage_msg =
 	"    -s SCALE          fraction of WCET to spin for (1.0 means 100%, default 0.95)\n"
 	"    -u SLACK          randomly under-run WCET by up to SLACK milliseconds\n"
 	"    -U SLACK-FRACTION randomly under-run WCET by up to (WCET * SLACK-FRACTION) milliseconds \n"
+	"    -y DIST           draw per-job execution times (in ms) from a distribution:\n"
+	"                      lognormal:MEAN:STDDEV, weibull:SHAPE:SCALE,\n"
+	"                      bimodal:P:MEAN1:STDDEV1:MEAN2:STDDEV2, or\n"
+	"                      gumbel:LOCATION:SCALE (samples are not capped at WCET)\n"
+	"    -z, --seed SEED   seed for all random choices (execution times, critical\n"
+	"                      section placement, suspensions, inter-arrival times);\n"
+	"                      identical seeds reproduce identical job sequences\n"
+	"                      (default: derived from time and PID)\n"
 	"    -v                verbose (print per-job statistics)\n"
 	"    -w                wait for synchronous release\n"
 	"\n"
@@ -66,6 +91,28 @@ const char *usage_msg =
 	"    -A FILE[:COLUMN]  load sporadic inter-arrival times from CSV file (implies -T);\n"
 	"                      if COLUMN is given, it specifies the column to read\n"
 	"                      inter-arrival times from (default: 1)\n"
+	"    -F TRACE          load per-job execution times, and if present, inter-arrival\n"
+	"                      times (implies -T), critical section lengths and\n"
+	"                      self-suspensions from a binary job trace (see csv2trace);\n"
+	"                      without DURATION, the trace is replayed once\n"
+	"\n"
+	"    -g SEGMENTS       split each job into SEGMENTS execution segments separated\n"
+	"                      by self-suspensions; per-segment response times are\n"
+	"                      reported at exit\n"
+	"    -G MIN[:MAX]      suspend for MIN milliseconds between segments, or for a\n"
+	"                      uniformly random time in [MIN, MAX] milliseconds\n"
+	"    -W SHM            instead of sleeping, wait until a completion is posted to\n"
+	"                      the POSIX shared memory object SHM (e.g., /rtspin-io);\n"
+	"                      with -G, give up after the suspension length\n"
+	"    -P SHM            post a completion to SHM whenever a job completes\n"
+	"\n"
+	"    -M WCET:PERIOD[,WCET:PERIOD...]\n"
+	"                      additional operating modes; mode 0 is given by the\n"
+	"                      WCET and PERIOD arguments. SIGUSR1 switches to the\n"
+	"                      next mode. Mode changes take effect at the next\n"
+	"                      release; their latency and the deadline misses\n"
+	"                      around them are reported\n"
+	"    -N FILE           switch to the mode whose number is written to FILE\n"
 	"\n"
 	"    -S[FILE]          read from FILE to trigger sporadic job releases\n"
 	"                      default w/o -S: periodic job releases\n"
@@ -82,12 +129,18 @@ const char *usage_msg =
 	"    -X PROTOCOL       access a shared resource protected by a locking protocol\n"
 	"    -L CS-LENGTH      simulate a critical section length of CS-LENGTH milliseconds\n"
 	"    -Q RESOURCE-ID    access the resource identified by RESOURCE-ID\n"
+	"    -x SPEC           access several, possibly nested resources in each job,\n"
+	"                      given as a comma-separated list of accesses\n"
+	"                      PROTOCOL:ID:CS-LENGTH[@PROBABILITY][{NESTED-ACCESSES}],\n"
+	"                      e.g., PCP:1:0.5{PCP:2:0.1@0.5},MPCP:3:0.2;\n"
+	"                      per-access blocking times are reported at exit\n"
 	"\n"
 	"Units:\n"
 	"    WCET and PERIOD are expected in milliseconds.\n"
 	"    SLACK is expected in milliseconds.\n"
 	"    DURATION is expected in seconds.\n"
 	"    CS-LENGTH is expected in milliseconds.\n"
+	"    MIN and MAX are expected in milliseconds.\n"
 	"    FOOTPRINT is expected in number of pages\n";
 
 
@@ -103,7 +156,6 @@ static void usage(char *error) {
 }
 
 #define NUMS 4096
-static int num[NUMS];
 static char* progname;
 
 static int nr_of_pages = 0;
@@ -111,21 +163,31 @@ static int page_size;
 static void *base = NULL;
 
 static int cycles_ms = 0;
-
-static noinline int loop(int count)
-{
-	int i, j = 0;
-	/* touch some numbers and do some math */
-	for (i = 0; i < count; i++) {
-		int index = i % NUMS;
-		j += num[index]++;
-		if (j > num[index])
-			num[index] = (j / 2) + 1;
-	}
-	return j;
-}
-
-#define loop_once() loop(NUMS)
+/* all random choices of the task */
+static struct rng task_rng;
+/* cost model of calib_workload(), valid if ns_per_loop > 0 */
+static struct calib_model loop_model;
+
+#define loop_once() calib_workload(NUMS)
+
+/* self-suspension segments */
+#define MAX_SEGMENTS 32
+static int num_segments = 1;
+static double suspension_min, suspension_max; /* seconds */
+/* if set, suspensions wait for completions posted to this shared word */
+static volatile uint32_t *completion_word;
+
+struct segment_stats {
+	unsigned long count;
+	lt_t total, min, max, last;
+};
+
+/* response time of each segment, measured from the job's release or the end
+ * of the preceding suspension, and the actual length of each suspension */
+static struct segment_stats segment_response[MAX_SEGMENTS];
+static struct segment_stats segment_suspension[MAX_SEGMENTS];
+/* number of segments of the most recent job */
+static int last_segments;
 
 static int loop_once_with_mem(void)
 {
@@ -135,7 +197,7 @@ static int loop_once_with_mem(void)
 
 	/* choose a random page */
 	if (nr_of_pages > 1)
-		rand = lrand48() % (nr_of_pages - 1);
+		rand = rng_below(&task_rng, nr_of_pages - 1);
 	else
 		rand = 0;
 
@@ -154,9 +216,9 @@ static int loop_for(double exec_time, double emergency_exit)
 {
 	int tmp = 0;
 
-	if (cycles_ms) {
-		double count = cycles_ms * exec_time * 1000;
-		tmp += loop(count);
+	if (loop_model.ns_per_loop > 0) {
+		tmp += calib_workload(calib_loops_for(&loop_model,
+		                                      s2ns(exec_time)));
 	} else {
 		double last_loop = 0, loop_start;
 		double start = cputime();
@@ -208,49 +270,255 @@ static void debug_delay_loop(void)
 
 static char input_buf[4096] = "<no input>";
 
-static int calibrate_ms(int ms)
+/* length of the longest probe of the calibration */
+#define CALIB_MAX_PROBE_MS 20
+
+static void calibrate(struct calib_model *model)
 {
-	int right = NUMS;
-	int left = 0;
-	int middle;
-
-	double start;
-	double now;
-	double dms = 0.001 * ms;
-
-	/*look for initial loop count values for binary search*/
-	for (;;)
-	{
-		printf("Probe %d loops for %d ms:\n", right, ms);
-		start = wctime();
-		loop(right);
-		now = wctime();
-		if ((now - start) >= dms)
-			break;
-		left = right;
-		right += right;
+	int ms[] = {1, 10, 100, 1000};
+	int i;
+
+	if (calib_fit(calib_workload, CALIB_MAX_PROBE_MS, model) != 0)
+		bail_out("calibration failed, too many outliers");
+
+	printf("Fitted %d samples (%d rejected as outliers):\n",
+	       model->samples, model->rejected);
+	printf("\tper loop:  %.4f ns (95%% CI: +/- %.4f ns)\n",
+	       model->ns_per_loop, model->ns_per_loop_ci);
+	printf("\toverhead:  %.1f ns (95%% CI: +/- %.1f ns)\n",
+	       model->overhead_ns, model->overhead_ci);
+	for (i = 0; i < sizeof(ms) / sizeof(ms[0]); i++)
+		printf("In %d ms %d loops.\n", ms[i],
+		       calib_loops_for(model, ms2ns(ms[i])));
+}
+
+/* length of each probe when re-validating a cached calibration result */
+#define CALIB_PROBE_MS 10
+/* accepted relative deviation of a probe from its expected length */
+#define CALIB_TOLERANCE 0.05
+
+static int calibration_still_valid(const struct calib_model *model)
+{
+	double best = -1, elapsed, error;
+	int loops = calib_loops_for(model, ms2ns(CALIB_PROBE_MS));
+	int i;
+
+	/* take the best of a few probes to filter out interruptions */
+	for (i = 0; i < 3; i++) {
+		elapsed = cputime();
+		calib_workload(loops);
+		elapsed = cputime() - elapsed;
+		if (best < 0 || elapsed < best)
+			best = elapsed;
 	}
 
-	middle = (left + right) / 2;
+	error = best * 1000 / CALIB_PROBE_MS - 1.0;
+	return -CALIB_TOLERANCE <= error && error <= CALIB_TOLERANCE;
+}
 
-	/*binary search for a loop count value for expected calibration time*/
-	while (left < middle)
-	{
-		start = wctime();
-		loop(middle);
-		now = wctime();
+/* The CPUs that the task may execute on: the CPUs of its domain if it is
+ * assigned to a partition or cluster, and otherwise its current affinity. */
+static int task_cpus(int migrate, int cluster, cpu_set_t *cpus)
+{
+	unsigned long long mask;
+	int cpu;
+
+	CPU_ZERO(cpus);
+	if (!migrate)
+		return sched_getaffinity(0, sizeof(*cpus), cpus);
+
+	if (domain_to_cpus(cluster, &mask) != 0)
+		return -1;
+	for (cpu = 0; cpu < sizeof(mask) * 8; cpu++)
+		if (mask & (1ULL << cpu))
+			CPU_SET(cpu, cpus);
+	return 0;
+}
 
-		printf("%d loops elapsed in %4.20f s\n", middle, now - start);
+/* Calibrate each class of CPUs in the given set once, on one of its members,
+ * and record the result for all members of the class. */
+static void calibrate_classes(const char *cache, cpu_set_t *cpus,
+			      struct calib_model *model)
+{
+	struct calib_key key, other;
+	cpu_set_t done;
+	int cpu, peer, max_cpu = num_online_cpus();
+
+	CPU_ZERO(&done);
+	for (cpu = 0; cpu < max_cpu; cpu++) {
+		if (!CPU_ISSET(cpu, cpus) || CPU_ISSET(cpu, &done))
+			continue;
+		if (calib_key_for_cpu(cpu, &key) != 0 ||
+		    be_migrate_to_cpu(cpu) < 0)
+			bail_out("could not pin calibration to a CPU");
+
+		printf("Calibrating on CPU %d (capacity %d, %s):\n",
+		       cpu, key.capacity, key.model);
+		calibrate(model);
+
+		for (peer = cpu; peer < max_cpu; peer++) {
+			if (!CPU_ISSET(peer, cpus) ||
+			    calib_key_for_cpu(peer, &other) != 0 ||
+			    !calib_same_class(&key, &other))
+				continue;
+			CPU_SET(peer, &done);
+			if (cache && calib_cache_store(cache, &other, model))
+				fprintf(stderr, "rtspin: could not update "
+					"calibration cache %s\n", cache);
+		}
+	}
+	if (cache)
+		printf("Stored calibration in %s.\n", cache);
+}
 
-		if ((now - start) < dms)
-			left = middle;
-		else if ((now - start) == dms)
-			return middle;
-		else
-			right = middle;
-		middle = (left + right) / 2;
+/* Pick the cached calibration that applies to the given set of CPUs. If the
+ * set spans CPUs of different speeds, the slowest class is used so that jobs
+ * do not exceed their execution time on any of them. */
+static int select_calibration(const char *cache, cpu_set_t *cpus,
+			      struct calib_model *model)
+{
+	struct calib_key key;
+	struct calib_model cached, here;
+	int cpu, max_cpu = num_online_cpus();
+	int cur = sched_getcpu();
+	double fastest = 0;
+
+	memset(model, 0, sizeof(*model));
+	memset(&here, 0, sizeof(here));
+	for (cpu = 0; cpu < max_cpu; cpu++) {
+		if (!CPU_ISSET(cpu, cpus))
+			continue;
+		if (calib_key_for_cpu(cpu, &key) != 0 ||
+		    calib_cache_lookup(cache, &key, &cached) != 0)
+			/* some CPU has not been calibrated */
+			return 0;
+		if (cpu == cur)
+			here = cached;
+		if (cached.ns_per_loop > model->ns_per_loop)
+			*model = cached;
+		if (!fastest || cached.ns_per_loop < fastest)
+			fastest = cached.ns_per_loop;
 	}
-	return middle;
+
+	if (!model->ns_per_loop)
+		return 0;
+
+	/* we can only probe the class of the CPU that we are running on */
+	if (here.ns_per_loop && !calibration_still_valid(&here)) {
+		fprintf(stderr, "rtspin: cached calibration for CPU %d is "
+			"stale, run 'rtspin -a 0' to update it\n", cur);
+		return 0;
+	}
+
+	if (model->ns_per_loop > fastest)
+		fprintf(stderr, "rtspin: task may run on CPUs of different "
+			"speeds, using the calibration of the slowest "
+			"(%.2fx slower than the fastest)\n",
+			model->ns_per_loop / fastest);
+
+	return 1;
+}
+
+/* operating modes */
+#define MAX_MODES 16
+/* jobs before and after a mode change checked for deadline misses */
+#define MODE_CHANGE_WINDOW 10
+
+struct mode {
+	double wcet_ms;
+	double period_ms;
+};
+
+static volatile sig_atomic_t requested_mode;
+static int num_modes = 1;
+
+/* only flips the requested mode; the main loop notes when it sees it */
+static void next_mode(int sig)
+{
+	requested_mode = (requested_mode + 1) % num_modes;
+}
+
+/* Note the time of a new mode request. */
+static void check_mode_request(int *seen_mode, lt_t *request_time)
+{
+	int mode = requested_mode;
+
+	if (mode != *seen_mode) {
+		*seen_mode = mode;
+		*request_time = litmus_clock();
+	}
+}
+
+static int parse_modes(char *str, struct mode *modes)
+{
+	char *tok, *period;
+	int n = 1, fail = 0;
+
+	for (tok = strtok(str, ","); tok; tok = strtok(NULL, ",")) {
+		if (n == MAX_MODES)
+			return -1;
+		period = strsplit(':', tok);
+		if (!period)
+			return -1;
+		modes[n].wcet_ms = str2double(tok, &fail);
+		modes[n].period_ms = fail ? 0 : str2double(period, &fail);
+		if (fail || modes[n].wcet_ms <= 0 ||
+		    modes[n].wcet_ms > modes[n].period_ms)
+			return -1;
+		n++;
+	}
+	return n;
+}
+
+/* Mode requested through the control file, or -1 if none. */
+static int read_mode_file(int fd)
+{
+	char buf[16];
+	ssize_t len;
+	int fail, mode;
+
+	len = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+	if (buf[len - 1] == '\n')
+		buf[len - 1] = '\0';
+	mode = str2int(buf, &fail);
+	return fail || mode < 0 || mode >= num_modes ? -1 : mode;
+}
+
+/* The kernel does not accept new parameters for a real-time task, so
+ * leave real-time mode at the boundary, apply the parameters, and return.
+ * Returns the release time of the first job in the new mode. */
+static lt_t change_mode(struct rt_task *param, const struct mode *mode,
+			lt_t boundary)
+{
+	struct control_page *cp;
+
+	if (boundary)
+		lt_sleep_until(boundary);
+
+	if (task_mode(BACKGROUND_TASK) != 0)
+		bail_out("could not leave real-time mode for a mode change");
+	param->exec_cost = ms2ns(mode->wcet_ms);
+	param->period = ms2ns(mode->period_ms);
+	param->relative_deadline = 0;
+	if (set_rt_task_param(gettid(), param) < 0)
+		bail_out("could not set parameters of the new mode");
+	if (task_mode(LITMUS_RT_TASK) != 0)
+		bail_out("could not re-enter real-time mode");
+
+	cp = get_ctrl_page();
+	return cp ? cp->release : litmus_clock();
+}
+
+static int count_bits(unsigned long long x)
+{
+	int n = 0;
+
+	for (; x; x &= x - 1)
+		n++;
+	return n;
 }
 
 static int wait_for_input(int event_fd)
@@ -298,20 +566,110 @@ static int generate_output(int output_fd)
 	return written == len;
 }
 
-static void job(double exec_time, double program_end, int lock_od, double cs_length)
+/* Decide which of the accesses in a list a job carries out. Returns their
+ * number and stores the total critical section length in *length. */
+static int choose_accesses(struct cs_spec *spec, int idx, int *chosen,
+			   double *length)
+{
+	int n = 0;
+
+	*length = 0;
+	for (; idx >= 0; idx = spec->access[idx].next_sibling) {
+		if (spec->access[idx].probability < 1 &&
+		    rng_uniform(&task_rng) >= spec->access[idx].probability)
+			continue;
+		chosen[n++] = idx;
+		*length += spec->access[idx].length;
+	}
+	return n;
+}
+
+static void access_resource(struct cs_spec *spec, int idx, double program_end)
+{
+	struct cs_access *a = spec->access + idx;
+	int nested[CS_SPEC_MAX_ACCESSES];
+	int i, n;
+	double nested_length, chunk;
+	lt_t before;
+
+	before = litmus_clock();
+	if (litmus_lock(a->od) != 0)
+		bail_out("could not lock resource");
+	cs_access_record(a, litmus_clock() - before);
+
+	/* spread the outer section's own work around the nested ones */
+	n = choose_accesses(spec, a->first_child, nested, &nested_length);
+	chunk = (a->length - nested_length) / (n + 1);
+	for (i = 0; i < n; i++) {
+		loop_for(chunk, program_end + 1);
+		access_resource(spec, nested[i], program_end);
+	}
+	loop_for(chunk, program_end + 1);
+
+	litmus_unlock(a->od);
+}
+
+static double spec_cs_length(struct cs_spec *spec)
+{
+	double length = 0;
+	int idx;
+
+	for (idx = spec->first; idx >= 0; idx = spec->access[idx].next_sibling)
+		length += spec->access[idx].length;
+	return length;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double*) a, y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+static void compute_with_spec(double exec_time, double program_end,
+			      struct cs_spec *spec)
+{
+	int chosen[CS_SPEC_MAX_ACCESSES];
+	double cuts[CS_SPEC_MAX_ACCESSES + 1];
+	double cs_total, non_cs, last = 0;
+	int i, n;
+
+	n = choose_accesses(spec, spec->first, chosen, &cs_total);
+	non_cs = exec_time - cs_total;
+	if (non_cs < 0)
+		non_cs = 0;
+
+	/* place the critical sections at random points of the job */
+	for (i = 0; i < n; i++)
+		cuts[i] = rng_uniform(&task_rng) * non_cs;
+	qsort(cuts, n, sizeof(double), cmp_double);
+	cuts[n] = non_cs;
+
+	for (i = 0; i < n; i++) {
+		loop_for(cuts[i] - last, program_end + 1);
+		last = cuts[i];
+		access_resource(spec, chosen[i], program_end);
+	}
+	loop_for(cuts[n] - last, program_end + 2);
+}
+
+static void compute(double exec_time, double program_end, int lock_od,
+		    double cs_length, struct cs_spec *spec)
 {
 	double chunk1, chunk2;
 
-	if (lock_od >= 0) {
+	if (spec) {
+		compute_with_spec(exec_time, program_end, spec);
+	} else if (lock_od >= 0) {
 		/* simulate critical section somewhere in the middle */
-		chunk1 = drand48() * (exec_time - cs_length);
+		chunk1 = rng_uniform(&task_rng) * (exec_time - cs_length);
 		chunk2 = exec_time - cs_length - chunk1;
 
 		/* non-critical section */
 		loop_for(chunk1, program_end + 1);
 
 		/* critical section */
-		litmus_lock(lock_od);
+		if (litmus_lock(lock_od) != 0)
+			bail_out("could not lock resource");
 		loop_for(cs_length, program_end + 1);
 		litmus_unlock(lock_od);
 
@@ -322,6 +680,140 @@ static void job(double exec_time, double program_end, int lock_od, double cs_len
 	}
 }
 
+static volatile uint32_t *map_completion_word(const char *name)
+{
+	void *word;
+	int fd;
+
+	fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+	if (fd < 0)
+		return NULL;
+	if (ftruncate(fd, sizeof(uint32_t)) != 0) {
+		close(fd);
+		return NULL;
+	}
+	word = mmap(NULL, sizeof(uint32_t), PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, 0);
+	close(fd);
+	return word == MAP_FAILED ? NULL : word;
+}
+
+/* The shared word counts posted, but not yet consumed completions. */
+static void post_completion(volatile uint32_t *word)
+{
+	__sync_fetch_and_add(word, 1);
+	syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static void wait_for_completion(volatile uint32_t *word, double timeout)
+{
+	double end = wctime() + timeout, left;
+	struct timespec ts, *tsp = NULL;
+	uint32_t val;
+
+	while (1) {
+		val = *word;
+		if (val > 0) {
+			if (__sync_bool_compare_and_swap(word, val, val - 1))
+				return;
+			continue;
+		}
+		if (timeout > 0) {
+			left = end - wctime();
+			if (left <= 0)
+				return;
+			ts.tv_sec  = (time_t) left;
+			ts.tv_nsec = (left - ts.tv_sec) * 1E9;
+			tsp = &ts;
+		}
+		syscall(SYS_futex, word, FUTEX_WAIT, 0, tsp, NULL, 0);
+	}
+}
+
+static void self_suspend(double length)
+{
+	if (completion_word)
+		wait_for_completion(completion_word, length);
+	else
+		lt_sleep(s2ns(length));
+}
+
+static void segment_record(struct segment_stats *stats, lt_t value)
+{
+	if (!stats->count || value < stats->min)
+		stats->min = value;
+	if (value > stats->max)
+		stats->max = value;
+	stats->total += value;
+	stats->last = value;
+	stats->count++;
+}
+
+static void job(double exec_time, double program_end, int lock_od,
+		double cs_length, double suspension, struct cs_spec *spec,
+		lt_t release)
+{
+	int i, n = num_segments;
+	double segment, length;
+	lt_t ready = release, now;
+
+	/* a suspension taken from a job trace splits the job at least once */
+	if (suspension > 0 && n < 2)
+		n = 2;
+
+	/* the critical sections all fall into the last segment, never
+	 * across a suspension */
+	if (spec)
+		segment = exec_time - spec_cs_length(spec);
+	else
+		segment = lock_od >= 0 ? exec_time - cs_length : exec_time;
+	segment /= n;
+	if (segment < 0)
+		segment = 0;
+
+	for (i = 0; i < n - 1; i++) {
+		loop_for(segment, program_end + 1);
+		now = litmus_clock();
+		segment_record(segment_response + i, now - ready);
+
+		if (suspension > 0)
+			length = suspension / (n - 1);
+		else
+			length = suspension_min +
+				rng_uniform(&task_rng) * (suspension_max - suspension_min);
+		self_suspend(length);
+		ready = litmus_clock();
+		segment_record(segment_suspension + i, ready - now);
+	}
+
+	compute(exec_time - segment * (n - 1), program_end, lock_od, cs_length,
+		spec);
+	segment_record(segment_response + n - 1, litmus_clock() - ready);
+	last_segments = n;
+}
+
+static void report_segments(void)
+{
+	struct segment_stats *s;
+	int i;
+
+	fprintf(stderr, "rtspin/%d: segments:\n", getpid());
+	for (i = 0; i < MAX_SEGMENTS && segment_response[i].count; i++) {
+		s = segment_response + i;
+		fprintf(stderr, "  segment %d: %lu jobs, response time "
+			"min/avg/max = %.3f/%.3f/%.3fms\n", i + 1, s->count,
+			ns2ms((double) s->min), ns2ms((double) s->total) / s->count,
+			ns2ms((double) s->max));
+		s = segment_suspension + i;
+		if (s->count)
+			fprintf(stderr, "  suspension %d: min/avg/max = "
+				"%.3f/%.3f/%.3fms\n", i + 1,
+				ns2ms((double) s->min),
+				ns2ms((double) s->total) / s->count,
+				ns2ms((double) s->max));
+	}
+}
+
 static lt_t choose_inter_arrival_time_ns(
 	double* arrival_times, int num_arrivals, int cur_job,
 	double range_min, double range_max)
@@ -331,12 +823,17 @@ static lt_t choose_inter_arrival_time_ns(
 	if (arrival_times)
 		iat_ms = arrival_times[cur_job % num_arrivals];
 	else
-		iat_ms = range_min + drand48() * (range_max - range_min);
+		iat_ms = range_min + rng_uniform(&task_rng) * (range_max - range_min);
 
 	return ms2ns(iat_ms);
 }
 
-#define OPTSTR "p:c:wlveo:s:m:q:r:X:L:Q:iRu:U:Bhd:C:S::O::TD:E:A:a:"
+#define OPTSTR "p:c:wlveo:s:m:q:r:X:L:Q:iRu:U:Bhd:C:S::O::TD:E:A:a:F:K:x:g:G:W:P:y:z:M:N:"
+
+static const struct option long_opts[] = {
+	{"seed", required_argument, NULL, 'z'},
+	{NULL, 0, NULL, 0}
+};
 
 int main(int argc, char** argv)
 {
@@ -358,8 +855,28 @@ int main(int argc, char** argv)
 	int wait = 0;
 	int test_loop = 0;
 	int caliber_ms = 0;
+	int calib_cache_set = 0;
+	cpu_set_t calib_cpus;
+	struct calib_model cached_model;
+	char calib_cache[PATH_MAX] = "";
 	int background_loop = 0;
 
+	struct distrib exec_distrib;
+	int use_distrib = 0;
+	unsigned long long seed = 0;
+	int seed_set = 0;
+	char *end;
+
+	/* mode changes */
+	struct mode modes[MAX_MODES];
+	char *mode_list = NULL;
+	int mode_fd = -1, cur_mode = 0, seen_mode = 0, file_mode;
+	lt_t boundary, mode_release, mode_request_time = 0;
+	struct sigaction mode_action;
+	unsigned long long miss_history = 0;
+	int missed, jobs_since_change = -1, misses_before = 0,
+	    misses_since_change = 0;
+
 	int cost_column = 1;
 	const char *cost_csv_file = NULL;
 	int num_jobs = 0;
@@ -370,6 +887,11 @@ int main(int argc, char** argv)
 	int num_arrival_times = 0;
 	double *arrival_times = NULL;
 
+	const char *trace_file = NULL;
+	struct job_trace trace;
+	const struct job_trace_record *rec = NULL;
+	double cs_time, suspension;
+
 	int want_enforcement = 0;
 	double duration = 0, start = 0;
 	double scale = 0.95;
@@ -402,10 +924,15 @@ int main(int argc, char** argv)
 	const char *lock_namespace = "./rtspin-locks";
 	int protocol = -1;
 	double cs_length = 1; /* millisecond */
+	struct cs_spec *cs_spec = NULL;
+
+	/* self-suspensions */
+	lt_t job_release;
+	volatile uint32_t *post_word = NULL;
 
 	progname = argv[0];
 
-	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+	while ((opt = getopt_long(argc, argv, OPTSTR, long_opts, NULL)) != -1) {
 		switch (opt) {
 		case 'w':
 			wait = 1;
@@ -457,6 +984,9 @@ int main(int argc, char** argv)
 			}
 			linux_sleep = 1;
 			break;
+		case 'F':
+			trace_file = optarg;
+			break;
 		case 'S':
 			sporadic = 1;
 			if (!optarg || strcmp(optarg, "-") == 0)
@@ -528,7 +1058,67 @@ int main(int argc, char** argv)
 			break;
 		case 'Q':
 			resource_id = want_non_negative_int(optarg, "-Q");
-
+			break;
+		case 'x':
+			cs_spec = malloc(sizeof(*cs_spec));
+			if (!cs_spec)
+				bail_out("couldn't allocate memory");
+			if (cs_spec_parse(optarg, cs_spec) != 0)
+				usage("Invalid resource access specification.");
+			break;
+		case 'g':
+			num_segments = want_positive_int(optarg, "-g");
+			if (num_segments > MAX_SEGMENTS)
+				usage("-g: too many segments");
+			break;
+		case 'G':
+			after_colon = strsplit(':', optarg);
+			suspension_min = want_non_negative_double(optarg, "-G");
+			suspension_max = after_colon ?
+				want_non_negative_double(after_colon, "-G") :
+				suspension_min;
+			if (suspension_max < suspension_min)
+				usage("-G: MAX must not be less than MIN");
+			suspension_min *= 0.001;
+			suspension_max *= 0.001;
+			break;
+		case 'W':
+			completion_word = map_completion_word(optarg);
+			if (!completion_word) {
+				fprintf(stderr, "Could not map '%s' (%m)\n",
+					optarg);
+				usage("-W requires a valid shared memory object.");
+			}
+			break;
+		case 'P':
+			post_word = map_completion_word(optarg);
+			if (!post_word) {
+				fprintf(stderr, "Could not map '%s' (%m)\n",
+					optarg);
+				usage("-P requires a valid shared memory object.");
+			}
+			break;
+		case 'y':
+			if (distrib_parse(optarg, &exec_distrib) != 0)
+				usage("Invalid execution-time distribution.");
+			use_distrib = 1;
+			break;
+		case 'z':
+			seed = strtoull(optarg, &end, 0);
+			if (!*optarg || *end)
+				usage("option -z requires an integer argument");
+			seed_set = 1;
+			break;
+		case 'M':
+			mode_list = optarg;
+			break;
+		case 'N':
+			mode_fd = open(optarg, O_RDONLY);
+			if (mode_fd == -1) {
+				fprintf(stderr, "Could not open file '%s' "
+					"(%m)\n", optarg);
+				usage("-N requires a valid file path.");
+			}
 			break;
 		case 'v':
 			verbose = 1;
@@ -545,6 +1135,15 @@ int main(int argc, char** argv)
 			if (!cycles_ms)
 				caliber_ms = 1;
 			break;
+		case 'K':
+			if (strcmp(optarg, "none") == 0)
+				calib_cache[0] = '\0';
+			else if (strlen(optarg) >= sizeof(calib_cache))
+				usage("-K: path too long");
+			else
+				strcpy(calib_cache, optarg);
+			calib_cache_set = 1;
+			break;
 		case ':':
 			usage("Argument missing.");
 			break;
@@ -575,7 +1174,13 @@ int main(int argc, char** argv)
 				memset(base + (idx * page_size), 1, page_size);
 	}
 
-	srand(getpid());
+	if (!seed_set)
+		seed = (unsigned long long) time(NULL) << 16 ^ getpid();
+	rng_seed(&task_rng, seed, 0);
+
+	/* the calibrated workload does not touch the data pages of -m */
+	if (cycles_ms && !nr_of_pages)
+		loop_model.ns_per_loop = 1E6 / cycles_ms;
 
 	if (test_loop) {
 		if (cycles_ms > 0)
@@ -586,10 +1191,16 @@ int main(int argc, char** argv)
 	}
 
 	if (caliber_ms) {
-		printf("In 1 ms %d loops.\n", calibrate_ms(1));
-		printf("In 10 ms %d loops.\n", calibrate_ms(10));
-		printf("In 100 ms %d loops.\n", calibrate_ms(100));
-		printf("In 1 s %d loops.\n", calibrate_ms(1000));
+		if (!calib_cache_set &&
+		    calib_cache_default_path(calib_cache,
+					     sizeof(calib_cache)) != 0)
+			calib_cache[0] = '\0';
+
+		/* calibrate each kind of CPU the task may run on */
+		if (task_cpus(migrate, cluster, &calib_cpus) != 0)
+			bail_out("could not determine CPUs to calibrate");
+		calibrate_classes(calib_cache[0] ? calib_cache : NULL,
+		                  &calib_cpus, &loop_model);
 		return 0;
 	}
 
@@ -603,8 +1214,17 @@ int main(int argc, char** argv)
 		return 0;
 	}
 
-	if (argc - optind < 3 || (argc - optind < 2 && !cost_csv_file))
+	if (argc - optind < 2 ||
+	    (argc - optind < 3 && !cost_csv_file && !trace_file))
 		usage("Arguments missing.");
+	if (cost_csv_file && trace_file)
+		usage("-C and -F cannot be combined.");
+	if (use_distrib && (cost_csv_file || trace_file))
+		usage("-y cannot be combined with -C or -F.");
+	if (cs_spec && protocol >= 0)
+		usage("-x and -X cannot be combined.");
+	if (num_segments > 1 && !suspension_max && !completion_word)
+		usage("-g requires a suspension length (-G) or -W.");
 
 	wcet_ms   = want_positive_double(argv[optind + 0], "WCET");
 	period_ms = want_positive_double(argv[optind + 1], "PERIOD");
@@ -622,7 +1242,7 @@ int main(int argc, char** argv)
 
 	if (period <= 0)
 		usage("The period must be a positive number.");
-	if (!cost_csv_file && wcet > period) {
+	if (!cost_csv_file && !trace_file && wcet > period) {
 		usage("The worst-case execution time must not "
 				"exceed the period.");
 	}
@@ -636,23 +1256,64 @@ int main(int argc, char** argv)
 					arrival_column, &num_arrival_times);
 
 
-	if (argc - optind < 3 && cost_csv_file)
+	if (trace_file) {
+		if (job_trace_open(trace_file, &trace) != 0)
+			usage("Could not load job trace.");
+		num_jobs = job_trace_length(&trace);
+		if (trace.hdr->flags & JOB_TRACE_HAS_ARRIVALS)
+			linux_sleep = 1;
+	}
+
+	if (argc - optind < 3 && (cost_csv_file || trace_file)) {
 		/* If duration is not given explicitly,
-		 * take duration from file. */
-		duration = num_jobs * period_ms * 0.001;
-	else
+		 * take duration from file: the trace's arrivals
+		 * span, if it has any, or one period per job. */
+		if (trace_file && (trace.hdr->flags & JOB_TRACE_HAS_ARRIVALS))
+			duration = job_trace_span_ns(&trace) * 1E-9;
+		if (duration <= 0)
+			duration = num_jobs * period_ms * 0.001;
+	} else
 		duration = want_positive_double(argv[optind + 2], "DURATION");
 
 	if (underrun_frac) {
 		underrun_ms = underrun_frac * wcet_ms;
 	}
 
+	modes[0].wcet_ms = wcet_ms;
+	modes[0].period_ms = period_ms;
+	if (mode_list) {
+		num_modes = parse_modes(mode_list, modes);
+		if (num_modes < 0)
+			usage("Invalid mode list.");
+		if (create_reservation)
+			usage("-M cannot be combined with -R.");
+		memset(&mode_action, 0, sizeof(mode_action));
+		mode_action.sa_handler = next_mode;
+		mode_action.sa_flags = SA_RESTART;
+		sigemptyset(&mode_action.sa_mask);
+		if (sigaction(SIGUSR1, &mode_action, NULL) != 0)
+			bail_out("could not install SIGUSR1 handler");
+	}
+
 	if (migrate) {
 		ret = be_migrate_to_domain(cluster);
 		if (ret < 0)
 			bail_out("could not migrate to target partition or cluster.");
 	}
 
+	/* a cached calibration is only used when asked for with -K */
+	if (!cycles_ms && !nr_of_pages && calib_cache[0]) {
+		if (task_cpus(migrate, cluster, &calib_cpus) == 0 &&
+		    select_calibration(calib_cache, &calib_cpus,
+		                       &cached_model)) {
+			loop_model = cached_model;
+			if (verbose)
+				fprintf(stderr, "rtspin: using cached "
+					"calibration of %.4f ns/loop\n",
+					loop_model.ns_per_loop);
+		}
+	}
+
 
 	init_rt_task_param(&param);
 	param.exec_cost = wcet;
@@ -688,7 +1349,11 @@ int main(int argc, char** argv)
 			bail_out("failed to create reservation");
 	}
 
-	srand48(time(NULL));
+	if (verbose)
+		fprintf(stderr, "rtspin: random seed %llu\n", seed);
+	if (use_distrib && verbose)
+		fprintf(stderr, "rtspin: mean execution time %.3fms\n",
+			distrib_mean(&exec_distrib));
 
 
 	init_litmus();
@@ -709,6 +1374,11 @@ int main(int argc, char** argv)
 		}
 	}
 
+	if (cs_spec) {
+		if (cs_spec_open_locks(cs_spec, lock_namespace, &cluster) != 0)
+			usage("Could not open locks.");
+	}
+
 
 	if (wait) {
 		ret = wait_for_ts_release();
@@ -735,6 +1405,8 @@ int main(int argc, char** argv)
 	while (1) {
 		double acet; /* actual execution time */
 
+		check_mode_request(&seen_mode, &mode_request_time);
+
 		if (sporadic) {
 			/* sporadic job activations, sleep until
 			 * we receive an "event" (= any data) from
@@ -748,6 +1420,17 @@ int main(int argc, char** argv)
 		if (wctime() > start + duration)
 			break;
 
+		/* segment response times are measured from the release */
+		if (sporadic)
+			job_release = litmus_clock();
+		else if (linux_sleep || !cp)
+			job_release = next_release;
+		else
+			job_release = cp->release;
+
+		if (report_interrupts && cp)
+			litmus_irq_job_begin();
+
 		if (verbose) {
 			get_job_no(&job_no);
 			fprintf(stderr, "rtspin/%d:%u @ %.4fms\n", gettid(),
@@ -784,12 +1467,27 @@ int main(int argc, char** argv)
 
 		/* figure out for how long this job should use the CPU */
 
-		if (cost_csv_file) {
+		cs_time = cs_length * 0.001;
+		suspension = 0;
+
+		if (trace_file) {
+			/* take next record from the mapped trace */
+			rec = job_trace_next(&trace);
+			acet = rec->exec_ns * 1E-9;
+			if (trace.hdr->flags & JOB_TRACE_HAS_LOCKS)
+				cs_time = rec->resource_id == resource_id ?
+					rec->cs_length_ns * 1E-9 : 0;
+			if (trace.hdr->flags & JOB_TRACE_HAS_SUSPENSIONS)
+				suspension = rec->suspension_ns * 1E-9;
+		} else if (cost_csv_file) {
 			/* read from provided CSV file and convert to seconds */
 			acet = exec_times[cur_job % num_jobs] * 0.001;
+		} else if (use_distrib) {
+			/* sample and convert to seconds */
+			acet = distrib_sample(&exec_distrib, &task_rng) * 0.001;
 		} else {
 			/* randomize and convert to seconds */
-			acet = (wcet_ms - drand48() * underrun_ms) * 0.001;
+			acet = (wcet_ms - rng_uniform(&task_rng) * underrun_ms) * 0.001;
 			if (acet < 0)
 				acet = 0;
 		}
@@ -803,13 +1501,91 @@ int main(int argc, char** argv)
 				(acet * 1000 / wcet_ms) * 100);
 
 		/* burn cycles */
-		job(acet, start + duration, lock_od, cs_length * 0.001);
+		job(acet, start + duration, cs_time > 0 ? lock_od : -1, cs_time,
+		    suspension, cs_spec, job_release);
+
+		/* only a calibrated workload's execution time is inflated by
+		 * interrupts; otherwise, it spins for the same CPU time */
+		if (report_interrupts && cp)
+			litmus_irq_job_end(loop_model.ns_per_loop > 0 ?
+					   s2ns(acet) : 0);
+
+		missed = cp && litmus_clock() > cp->deadline;
+		miss_history = (miss_history << 1) | missed;
+		if (jobs_since_change >= 0) {
+			misses_since_change += missed;
+			if (++jobs_since_change == MODE_CHANGE_WINDOW) {
+				fprintf(stderr, "rtspin/%d: deadline misses "
+					"around mode change: %d of %d jobs "
+					"before, %d of %d jobs after\n",
+					gettid(), misses_before,
+					MODE_CHANGE_WINDOW, misses_since_change,
+					MODE_CHANGE_WINDOW);
+				jobs_since_change = -1;
+			}
+		}
+
+		if (verbose && last_segments > 1) {
+			for (idx = 0; idx < last_segments; idx++)
+				fprintf(stderr, "\tsegment %d: response time "
+					"%.3fms\n", idx + 1, ns2ms((double)
+					segment_response[idx].last));
+		}
 
 		if (want_output) {
 			/* generate some output at end of job */
 			generate_output(output_fd);
 		}
 
+		if (post_word)
+			post_completion(post_word);
+
+		if (mode_fd >= 0 && (file_mode = read_mode_file(mode_fd)) >= 0 &&
+		    file_mode != requested_mode)
+			requested_mode = file_mode;
+		check_mode_request(&seen_mode, &mode_request_time);
+
+		if (seen_mode != cur_mode) {
+			/* switch when the next job of the old mode would be
+			 * released, so that no release comes early */
+			if (sporadic)
+				boundary = 0;
+			else if (linux_sleep)
+				boundary = next_release + inter_arrival_time;
+			else
+				boundary = cp ? cp->release + period : 0;
+
+			cur_mode = seen_mode;
+			mode_release = change_mode(&param, modes + cur_mode,
+						   boundary);
+
+			/* scale inter-arrival times along with the period */
+			inter_arrival_min_ms *= modes[cur_mode].period_ms /
+						period_ms;
+			inter_arrival_max_ms *= modes[cur_mode].period_ms /
+						period_ms;
+			wcet_ms = modes[cur_mode].wcet_ms;
+			period_ms = modes[cur_mode].period_ms;
+			period = ms2ns(period_ms);
+			if (underrun_frac)
+				underrun_ms = underrun_frac * wcet_ms;
+			inter_arrival_time = period;
+			next_release = mode_release;
+
+			misses_before = count_bits(miss_history &
+				((1ULL << MODE_CHANGE_WINDOW) - 1));
+			misses_since_change = 0;
+			jobs_since_change = 0;
+			fprintf(stderr, "rtspin/%d: mode change to %d "
+				"(%.2fms/%.2fms), latency %.3fms\n", gettid(),
+				cur_mode, wcet_ms, period_ms,
+				ns2ms((double) (mode_release - mode_request_time)));
+
+			/* the first job of the new mode is already released */
+			cur_job++;
+			continue;
+		}
+
 		/* wait for periodic job activation (unless sporadic) */
 		if (!sporadic) {
 			/* periodic job activations */
@@ -818,13 +1594,18 @@ int main(int argc, char** argv)
 				 * active LITMUS^RT plugin like a
 				 * self-suspension. */
 
-				inter_arrival_time =
-					choose_inter_arrival_time_ns(
-				        	arrival_times,
-				                num_arrival_times,
-				                cur_job,
-				                inter_arrival_min_ms,
-				                inter_arrival_max_ms);
+				if (rec && (trace.hdr->flags &
+				            JOB_TRACE_HAS_ARRIVALS))
+					inter_arrival_time =
+						rec->inter_arrival_ns;
+				else
+					inter_arrival_time =
+						choose_inter_arrival_time_ns(
+					        	arrival_times,
+					                num_arrival_times,
+					                cur_job,
+					                inter_arrival_min_ms,
+					                inter_arrival_max_ms);
 
 				next_release += inter_arrival_time;
 
@@ -862,6 +1643,26 @@ int main(int argc, char** argv)
 	if (cost_csv_file)
 		free(exec_times);
 
+	if (trace_file)
+		job_trace_close(&trace);
+
+	if (cs_spec) {
+		cs_spec_report(cs_spec, stderr);
+		free(cs_spec);
+	}
+
+	if (segment_response[1].count)
+		report_segments();
+
+	if (report_interrupts && cp) {
+		struct litmus_irq_stats irq_stats;
+		char label[32];
+
+		litmus_irq_stats_get(&irq_stats);
+		snprintf(label, sizeof(label), "rtspin/%d: interrupts", gettid());
+		litmus_irq_stats_print(stderr, label, &irq_stats);
+	}
+
 	if (base != MAP_FAILED)
 		munlock(base, rss);
 
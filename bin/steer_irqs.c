@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "litmus.h"
+#include "common.h"
+#include "irq_affinity.h"
+
+const char *usage_msg =
+	"Usage: steer_irqs [OPTIONS]\n"
+	"\n"
+	"Move device interrupts off the CPUs that run real-time tasks. The\n"
+	"real-time CPUs are those of the scheduling domains of the active plugin\n"
+	"except the release master; interrupts are steered to the release\n"
+	"master if there is one, and to the remaining CPUs otherwise. The\n"
+	"per-CPU interrupt rates (device interrupts and all interrupts, per\n"
+	"second) are reported before and after the change.\n"
+	"\n"
+	"Options:\n"
+	"    -c CPUS           real-time CPUs (e.g., 1-3,5) instead of the domains;\n"
+	"                      interrupts are steered to the remaining CPUs\n"
+	"    -t CPUS           CPUs to steer interrupts to instead of the release\n"
+	"                      master or the remaining CPUs\n"
+	"    -d DURATION       rate measurement interval in seconds (default: 1)\n"
+	"    -r ROOT           use ROOT instead of /proc for interrupt files\n"
+	"    -n                only report the rates, do not change affinities\n"
+	"    -h                show this help message\n"
+	"\n"
+	"Output columns: cpu,rt,device_before,all_before,device_after,all_after\n"
+	"\n";
+
+static void usage(char *error) {
+	if (error)
+		fprintf(stderr, "Error: %s\n\n", error);
+	fprintf(stderr, "%s", usage_msg);
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/* parse a CPU list such as "0,2-3" */
+static unsigned long long parse_cpus(const char *arg)
+{
+	unsigned long long mask = 0;
+	char *end;
+	long lo, hi;
+
+	do {
+		lo = hi = strtol(arg, &end, 10);
+		if (end == arg)
+			usage("Bad CPU list.");
+		if (*end == '-') {
+			arg = end + 1;
+			hi = strtol(arg, &end, 10);
+			if (end == arg)
+				usage("Bad CPU list.");
+		}
+		if (lo < 0 || hi >= IRQ_MAX_CPUS || lo > hi)
+			usage("Bad CPU list.");
+		for (; lo <= hi; lo++)
+			mask |= 1ULL << lo;
+		arg = end + 1;
+	} while (*end == ',');
+
+	if (*end)
+		usage("Bad CPU list.");
+	return mask;
+}
+
+/* per-CPU interrupts per second over the given interval */
+static int measure_rates(double interval, double *device, double *all)
+{
+	unsigned long long dev0[IRQ_MAX_CPUS], all0[IRQ_MAX_CPUS];
+	unsigned long long dev1[IRQ_MAX_CPUS], all1[IRQ_MAX_CPUS];
+	int num_cpus, i;
+
+	if (irq_read_counts(dev0, all0, IRQ_MAX_CPUS) < 0)
+		bail_out("could not read interrupt counts");
+	usleep((useconds_t) (interval * 1000000));
+	num_cpus = irq_read_counts(dev1, all1, IRQ_MAX_CPUS);
+	if (num_cpus < 0)
+		bail_out("could not read interrupt counts");
+
+	for (i = 0; i < num_cpus; i++) {
+		device[i] = (dev1[i] - dev0[i]) / interval;
+		all[i] = (all1[i] - all0[i]) / interval;
+	}
+	return num_cpus;
+}
+
+#define OPTSTR "c:t:d:r:nh"
+
+int main(int argc, char** argv)
+{
+	unsigned long long rt = 0, housekeeping = 0;
+	double interval = 1, dev_before[IRQ_MAX_CPUS], all_before[IRQ_MAX_CPUS];
+	double dev_after[IRQ_MAX_CPUS], all_after[IRQ_MAX_CPUS];
+	int opt, i, num_cpus, dry_run = 0, moved = 0, failed = 0;
+	int rt_given = 0, housekeeping_given = 0;
+	unsigned long long default_housekeeping = 0;
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != -1) {
+		switch (opt) {
+		case 'c':
+			rt = parse_cpus(optarg);
+			rt_given = 1;
+			break;
+		case 't':
+			housekeeping = parse_cpus(optarg);
+			housekeeping_given = 1;
+			break;
+		case 'd':
+			interval = want_positive_double(optarg, "-d");
+			break;
+		case 'r':
+			if (irq_set_proc_root(optarg) != 0)
+				usage("Procfs root path too long.");
+			break;
+		case 'n':
+			dry_run = 1;
+			break;
+		case 'h':
+			usage(NULL);
+			break;
+		case ':':
+			usage("Argument missing.");
+			break;
+		case '?':
+		default:
+			usage("Bad argument.");
+			break;
+		}
+	}
+
+	if (!rt_given) {
+		if (irq_rt_cpus(&rt, &default_housekeeping) != 0)
+			bail_out("could not read the scheduling domains (use -c)");
+	} else {
+		/* the rest of the CPUs that are online */
+		for (i = 0; i < num_online_cpus() && i < IRQ_MAX_CPUS; i++)
+			default_housekeeping |= 1ULL << i;
+		default_housekeeping &= ~rt;
+	}
+	if (!housekeeping_given)
+		housekeeping = default_housekeeping;
+	if (rt & housekeeping)
+		usage("Real-time and housekeeping CPUs overlap.");
+	if (!dry_run && !housekeeping)
+		bail_out("no CPU left to handle interrupts");
+
+	num_cpus = measure_rates(interval, dev_before, all_before);
+
+	if (!dry_run) {
+		if (irq_steer_away(rt, housekeeping, &moved, &failed) != 0)
+			bail_out("could not change interrupt affinities");
+		fprintf(stderr, "steer_irqs: %d interrupts moved, %d could not "
+			"be moved\n", moved, failed);
+		num_cpus = measure_rates(interval, dev_after, all_after);
+	} else {
+		memcpy(dev_after, dev_before, sizeof(dev_after));
+		memcpy(all_after, all_before, sizeof(all_after));
+	}
+
+	printf("cpu,rt,device_before,all_before,device_after,all_after\n");
+	for (i = 0; i < num_cpus; i++)
+		printf("%d,%d,%.1f,%.1f,%.1f,%.1f\n", i, (int) (rt >> i & 1),
+		       dev_before[i], all_before[i], dev_after[i], all_after[i]);
+
+	return 0;
+}
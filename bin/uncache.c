@@ -10,6 +10,8 @@
 #include <sys/mman.h>
 #include <inttypes.h>
 
+#include "rng.h"
+
 /* Test tool for validating Litmus's uncache device.     */
 /* Tool also capable basic cache vs. sysmem statistics.  */
 /* Compile with '-O2' for significaintly greater margins */
@@ -311,20 +313,268 @@ int do_max_alloc(void)
 	return 0;
 }
 
+/* Benchmark suite: latency and bandwidth of uncached vs. cacheable memory
+   for several working set sizes, access patterns, and read/write mixes.
+   All accesses are to 64-bit words. */
+
+#define LINE_SIZE 64
+#define DEFAULT_SIZES "4,32,256,2048"
+#define MAX_SIZES 16
+
+typedef enum
+{
+	SEQUENTIAL,
+	STRIDED,
+	RANDOM
+} pattern_t;
+
+static const char* pattern_names[] = {"seq", "stride", "random"};
+
+/* allocate size bytes of uncached memory, or NULL */
+static volatile uint64_t* alloc_uncached(size_t size)
+{
+	void* data;
+	int fd = open(UNCACHE_DEV, O_RDWR);
+
+	if (fd < 0)
+		return NULL;
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	return data == MAP_FAILED ? NULL : data;
+}
+
+static volatile uint64_t* alloc_cached(size_t size)
+{
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return data == MAP_FAILED ? NULL : data;
+}
+
+static int64_t elapsed_ns(struct timespec start)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start.tv_sec) * 1000000000LL +
+		(end.tv_nsec - start.tv_nsec);
+}
+
+/* nr independent accesses; returns elapsed ns */
+static int64_t run_accesses(volatile uint64_t* data, size_t size,
+			    pattern_t pattern, size_t stride, int write_pct,
+			    long nr)
+{
+	size_t words = size / sizeof(uint64_t);
+	size_t step = pattern == STRIDED ? stride / sizeof(uint64_t) : 1;
+	size_t idx = 0;
+	uint64_t sum = 0;
+	struct rng rng;
+	struct timespec start;
+	long i;
+	int mix = 0;
+
+	if (!step)
+		step = 1;
+	rng_seed(&rng, 1, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < nr; i++) {
+		if (pattern == RANDOM)
+			idx = rng_below(&rng, words);
+		else if (idx + step < words)
+			idx += step;
+		else if (pattern == STRIDED)
+			/* start the next pass one line further, so that
+			   all lines are accessed */
+			idx = (idx + step + LINE_SIZE / sizeof(uint64_t)) % words;
+		else
+			idx = (idx + step) % words;
+
+		/* spread write_pct writes evenly over every 100 accesses */
+		mix += write_pct;
+		if (mix >= 100) {
+			mix -= 100;
+			data[idx] = i;
+		} else
+			sum += data[idx];
+	}
+	/* keep the reads */
+	asm("" : : "r"(sum));
+	return elapsed_ns(start);
+}
+
+/* dependent loads along a random cycle through all cache lines of the
+   buffer; returns elapsed ns */
+static int64_t run_chase(volatile uint64_t* data, size_t size, long nr)
+{
+	size_t lines = size / LINE_SIZE;
+	size_t per_line = LINE_SIZE / sizeof(uint64_t);
+	size_t* order;
+	size_t i, j, tmp, next;
+	struct rng rng;
+	struct timespec start;
+	long k;
+
+	order = malloc(lines * sizeof(size_t));
+	if (!order)
+		return -1;
+	for (i = 0; i < lines; i++)
+		order[i] = i;
+	rng_seed(&rng, 1, 0);
+	for (i = lines - 1; i > 0; i--) {
+		j = rng_below(&rng, i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	for (i = 0; i < lines; i++)
+		data[order[i] * per_line] = order[(i + 1) % lines] * per_line;
+	free(order);
+
+	next = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (k = 0; k < nr; k++)
+		next = data[next];
+	asm("" : : "r"(next));
+	return elapsed_ns(start);
+}
+
+static void report_run(const char* mem, size_t size, const char* pattern,
+		       int write_pct, long nr, int64_t ns)
+{
+	printf("%s,%zu,%s,%d,%ld,%.2f,%.1f\n", mem, size / 1024, pattern,
+	       write_pct, nr, (double)ns / nr,
+	       nr * sizeof(uint64_t) / ((double)ns / 1e9) / 1e6);
+}
+
+/* one memory kind, all sizes, patterns, and mixes */
+static int suite_memory(const char* mem, int uncached, size_t* sizes,
+			int nr_sizes, size_t stride, long nr)
+{
+	static const int mixes[] = {0, 50, 100};
+	volatile uint64_t* data;
+	size_t set_stride;
+	int s, p, m;
+	int64_t ns;
+
+	for (s = 0; s < nr_sizes; s++) {
+		/* by default, one page, or half of a single-page set */
+		set_stride = stride ? stride :
+			sizes[s] > PAGE_SIZE ? PAGE_SIZE : sizes[s] / 2;
+		data = uncached ? alloc_uncached(sizes[s]) :
+			alloc_cached(sizes[s]);
+		if (!data) {
+			printf("Failed to alloc %zu bytes of %s memory!\n",
+			       sizes[s], mem);
+			return -1;
+		}
+		/* fault in and warm up */
+		run_accesses(data, sizes[s], SEQUENTIAL, 0, 100,
+			     sizes[s] / sizeof(uint64_t));
+
+		for (p = SEQUENTIAL; p <= RANDOM; p++)
+			for (m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+				ns = run_accesses(data, sizes[s], p, set_stride,
+						  mixes[m], nr);
+				report_run(mem, sizes[s], pattern_names[p],
+					   mixes[m], nr, ns);
+			}
+
+		if (sizes[s] >= 2 * LINE_SIZE) {
+			ns = run_chase(data, sizes[s], nr);
+			if (ns >= 0)
+				report_run(mem, sizes[s], "chase", 0, nr, ns);
+		}
+
+		munmap((char*)data, sizes[s]);
+	}
+	return 0;
+}
+
+int do_suite(char* size_list, size_t stride, long nr)
+{
+	size_t sizes[MAX_SIZES];
+	int nr_sizes = 0, fd;
+	char* item;
+	const char* uncached_mem = "uncache";
+	int uncached = 1;
+
+	for (item = strtok(size_list, ","); item && nr_sizes < MAX_SIZES;
+	     item = strtok(NULL, ",")) {
+		sizes[nr_sizes] = strtoul(item, NULL, 10) * 1024;
+		/* whole pages, as the device maps pages */
+		sizes[nr_sizes] = (sizes[nr_sizes] + PAGE_SIZE - 1) /
+			PAGE_SIZE * PAGE_SIZE;
+		if (!sizes[nr_sizes]) {
+			printf("invalid size: %s\n", item);
+			return -1;
+		}
+		/* the strided pattern must fit several accesses per pass */
+		if (stride && stride >= sizes[nr_sizes]) {
+			printf("stride must be smaller than size %s KiB\n",
+			       item);
+			return -1;
+		}
+		nr_sizes++;
+	}
+
+	fd = open(UNCACHE_DEV, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "%s not available, measuring anonymous "
+			"memory instead.\n", UNCACHE_DEV);
+		uncached_mem = "anon-fallback";
+		uncached = 0;
+	} else
+		close(fd);
+
+	mlockall(MCL_CURRENT | MCL_FUTURE);
+
+	printf("memory,size_kb,pattern,write_pct,accesses,ns_per_access,"
+	       "mb_per_s\n");
+	if (suite_memory("cache", 0, sizes, nr_sizes, stride, nr) != 0)
+		return -1;
+	return suite_memory(uncached_mem, uncached, sizes, nr_sizes, stride,
+			    nr);
+}
+
+const char *usage_msg =
+	"Usage: uncache [-u | -c | -x | -a | -b [-s SIZES] [-S STRIDE] [-n NR]]\n"
+	"\n"
+	"    -u    time accesses to uncached pages (default)\n"
+	"    -c    time accesses to cacheable pages\n"
+	"    -x    compare cached and uncached pages\n"
+	"    -a    allocate uncached pages until allocation fails\n"
+	"    -b    benchmark suite: per-access time and bandwidth of cacheable\n"
+	"          and uncached memory for each working set size, pattern\n"
+	"          (sequential, strided, random, and dependent random loads),\n"
+	"          and share of writes (0, 50, 100%), as CSV; anonymous memory\n"
+	"          stands in for uncached memory if " UNCACHE_DEV "\n"
+	"          is not available\n"
+	"    -s    working set sizes in KB (default: " DEFAULT_SIZES ")\n"
+	"    -S    stride of the strided pattern in bytes, smaller than each\n"
+	"          size (default: page size, or half a page for one-page sets)\n"
+	"    -n    accesses per measurement (default: 262144)\n"
+	"    -h    show this help message\n"
+	"\n";
+
 typedef enum
 {
 	UNCACHE,
 	CACHE,
 	COMPARE,
-	MAX_ALLOC
+	MAX_ALLOC,
+	SUITE
 } test_t;
 
-#define OPTSTR "ucxa"
+#define OPTSTR "ucxabs:S:n:h"
 int main(int argc, char** argv)
 {
 	int ret;
 	test_t test = UNCACHE;
 	int opt;
+	char default_sizes[] = DEFAULT_SIZES;
+	char* sizes = default_sizes;
+	size_t stride = 0;
+	long nr = 1 << 18;
 	PAGE_SIZE = sysconf(_SC_PAGE_SIZE);
 
 	while((opt = getopt(argc, argv, OPTSTR)) != -1) {
@@ -341,6 +591,25 @@ int main(int argc, char** argv)
 			case 'a':
 				test = MAX_ALLOC;
 				break;
+			case 'b':
+				test = SUITE;
+				break;
+			case 's':
+				sizes = optarg;
+				break;
+			case 'S':
+				stride = strtoul(optarg, NULL, 10);
+				break;
+			case 'n':
+				nr = strtol(optarg, NULL, 10);
+				if (nr <= 0) {
+					printf("bad number of accesses\n");
+					exit(-1);
+				}
+				break;
+			case 'h':
+				printf("%s", usage_msg);
+				exit(0);
 			case ':':
 				printf("missing option\n");
 				exit(-1);
@@ -352,7 +621,8 @@ int main(int argc, char** argv)
 	}
 
 
-	printf("Page Size: %d\n", PAGE_SIZE);
+	if (test != SUITE)
+		printf("Page Size: %d\n", PAGE_SIZE);
 
 	switch(test)
 	{
@@ -368,6 +638,9 @@ int main(int argc, char** argv)
 	case MAX_ALLOC:
 		ret = do_max_alloc();
 		break;
+	case SUITE:
+		ret = do_suite(sizes, stride, nr);
+		break;
 	default:
 		printf("invalid test\n");
 		ret = -1;
@@ -0,0 +1,141 @@
+/**
+ * @file calibration.h
+ * Persistent cache of rtspin workload calibration results
+ *
+ * The number of loop iterations that rtspin's workload executes per
+ * millisecond depends on the processor model, its microcode, and the active
+ * frequency governor. Calibration results are therefore stored per CPU and
+ * tagged with these properties; a cached value is only used if all of them
+ * still match.
+ *
+ * On heterogeneous (e.g., big.LITTLE) systems, CPUs with the same model and
+ * capacity form a CPU class. The workload is calibrated once per class and
+ * the result is recorded for every CPU of the class.
+ *
+ * A calibration result is a linear model of the workload's cost: a fixed
+ * overhead per invocation plus a cost per loop iteration, fitted by least
+ * squares to repeated measurements of the thread's CPU time.
+ */
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stddef.h>
+#include <limits.h>
+
+/**
+ * Linear cost model of a workload loop
+ */
+struct calib_model {
+	double overhead_ns;    /**< Fixed cost per invocation */
+	double ns_per_loop;    /**< Cost per loop iteration */
+	double overhead_ci;    /**< Half-width of the 95% confidence interval
+	                            of overhead_ns (0 if unknown) */
+	double ns_per_loop_ci; /**< Half-width of the 95% confidence interval
+	                            of ns_per_loop (0 if unknown) */
+	int    samples;        /**< Number of samples used for the fit */
+	int    rejected;       /**< Number of samples rejected as outliers */
+};
+
+/**
+ * The reference workload: touch some numbers and do some math.
+ * @param loops Number of loop iterations to execute
+ * @return Arbitrary value (to keep the compiler from eliding the work)
+ */
+int calib_workload(int loops);
+
+/**
+ * Workload to be calibrated
+ * @param loops Number of loop iterations to execute
+ * @return Arbitrary value (to keep the compiler from eliding the work)
+ */
+typedef int (*calib_workload_t)(int loops);
+
+/**
+ * Fit a linear cost model to a workload. The workload is run for several
+ * iteration counts up to about max_probe_ms milliseconds, with repeated
+ * samples per count. Samples deviating from the median of their count by
+ * more than three (scaled) median absolute deviations are rejected as
+ * outliers before the fit.
+ * @param workload Workload to calibrate
+ * @param max_probe_ms Approximate length of the longest probe
+ * @param model Model to fill in
+ * @return 0 on success, -1 if too few samples remained
+ */
+int calib_fit(calib_workload_t workload, double max_probe_ms,
+	      struct calib_model *model);
+
+/**
+ * Number of loop iterations that take the given amount of time.
+ * @param model Cost model of the workload
+ * @param ns Desired execution time in nanoseconds
+ * @return Number of loop iterations (0 if ns does not exceed the overhead)
+ */
+static inline int calib_loops_for(const struct calib_model *model, double ns)
+{
+	double loops = (ns - model->overhead_ns) / model->ns_per_loop;
+	if (loops < 1)
+		return 0;
+	return loops < INT_MAX ? (int) loops : INT_MAX;
+}
+
+/**
+ * Properties of a CPU that a calibration result depends on
+ */
+struct calib_key {
+	int  cpu;            /**< CPU index */
+	int  capacity;       /**< Relative capacity (1024 = fastest CPU),
+	                          -1 if not reported by the kernel */
+	char model[128];     /**< Processor model as reported by /proc/cpuinfo */
+	char microcode[32];  /**< Microcode revision, "-" if unknown */
+	char governor[32];   /**< cpufreq scaling governor, "-" if unknown */
+};
+
+/**
+ * Determine the calibration key of a CPU.
+ * @param cpu CPU index
+ * @param key Key to fill in
+ * @return 0 on success, -1 if the CPU is not listed in /proc/cpuinfo
+ */
+int calib_key_for_cpu(int cpu, struct calib_key *key);
+
+/**
+ * Check whether two CPUs belong to the same CPU class, i.e., whether
+ * a calibration result for one of them also applies to the other.
+ * @param a Key of the first CPU
+ * @param b Key of the second CPU
+ * @return 1 if both CPUs are of the same class, 0 otherwise
+ */
+int calib_same_class(const struct calib_key *a, const struct calib_key *b);
+
+/**
+ * Determine the location of the calibration cache. The path is taken from
+ * $RTSPIN_CALIBRATION_CACHE if set, and otherwise defaults to
+ * rtspin-calibration in $XDG_CACHE_HOME or ~/.cache.
+ * @param buf Buffer to store the path in
+ * @param len Size of buf
+ * @return 0 on success, -1 if no suitable location could be determined
+ */
+int calib_cache_default_path(char *buf, size_t len);
+
+/**
+ * Look up a cached calibration result.
+ * @param file Path of the cache file
+ * @param key Key of the CPU of interest
+ * @param model Cached cost model (output, without confidence intervals)
+ * @return 0 if a matching entry was found, -1 otherwise
+ */
+int calib_cache_lookup(const char *file, const struct calib_key *key,
+		       struct calib_model *model);
+
+/**
+ * Store a calibration result, replacing any previous entry for the same CPU.
+ * @param file Path of the cache file
+ * @param key Key of the calibrated CPU
+ * @param model Fitted cost model
+ * @return 0 on success, -1 otherwise
+ */
+int calib_cache_store(const char *file, const struct calib_key *key,
+		      const struct calib_model *model);
+
+#endif
@@ -6,6 +6,8 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include "litmus.h"
+
 #if defined(__GNUC__)
 #define noinline      __attribute__((__noinline__))
 #else
@@ -53,6 +55,74 @@ double* csv_read_column(const char *file, int column, int *num_rows);
  */
 char* strsplit(char separator, char *str);
 
+/**
+ * Busy-wait for the given time (measured with litmus_clock()).
+ * @param ns Time to spin in nanoseconds
+ */
+void spin_for(lt_t ns);
+
+/**
+ * Count the scheduling domains (partitions or clusters) of the active
+ * plugin by probing domain_to_cpus().
+ * @return Number of domains (0 if none can be read)
+ */
+int count_domains(void);
+
+/**
+ * Run num_tasks tasks in forked processes that all wait for synchronous
+ * releases (wait_for_ts_release()). Each round, once every task that is
+ * still running is waiting, the tasks are released with release_ts(). If a
+ * task exits early, no further rounds are released and the remaining
+ * tasks are killed.
+ * @param num_tasks Number of processes to fork
+ * @param rounds Number of synchronous releases
+ * @param delay Delay of each release (see release_ts())
+ * @param task Body of each process, called with the index of the process
+ *        (0 to num_tasks - 1) and arg; its return value is the exit status
+ * @param arg Passed to task
+ * @return 0 if all tasks exited with status 0, -1 otherwise
+ */
+int run_released_tasks(int num_tasks, int rounds, lt_t delay,
+		       int (*task)(int idx, void *arg), void *arg);
+
+/**
+ * Size of CPU 0's data (or unified) cache at the given level, as reported
+ * in /sys/devices/system/cpu/cpu0/cache.
+ * @param level Cache level (1 for L1, etc.)
+ * @return Size in bytes, or 0 if the level is not reported
+ */
+long cache_size(int level);
+
+/**
+ * Size of the last-level cache (see cache_size()).
+ * @return Size in bytes, or 0 if no cache is reported
+ */
+long last_level_cache_size(void);
+
+/** Distribution of a set of samples, e.g., cycle counts or latencies. */
+struct sample_stats {
+	int n;
+	unsigned long long min, p50, p90, p99, p999, max;
+	double mean;
+};
+
+/**
+ * Sort samples in place and summarize their distribution.
+ * @param samples Array of unsigned 32-bit or 64-bit values (e.g., cycles_t
+ *        or lt_t)
+ * @param size Size of one value in bytes
+ * @param n Number of samples (must be positive)
+ * @param stats Receives the summary
+ */
+void sample_stats(void *samples, size_t size, int n,
+		  struct sample_stats *stats);
+
+/**
+ * Print the CSV columns samples,min,p50,p90,p99,max,mean and a newline.
+ * @param stats Summary computed by sample_stats()
+ */
+void print_sample_stats(const struct sample_stats *stats);
+
 /* the following macros assume that there is a no-return function called usage() */
 
 #define want_int_min(arg, min, msg) ({	\
@@ -0,0 +1,96 @@
+/**
+ * @file cs_spec.h
+ * Resource access specifications for rtspin
+ *
+ * A resource access specification describes the critical sections that each
+ * job of an rtspin task executes. It is a comma-separated list of accesses
+ *
+ *     PROTOCOL:ID:LENGTH[@PROBABILITY][{NESTED-ACCESSES}]
+ *
+ * where PROTOCOL is a locking protocol name (as accepted by
+ * lock_protocol_for_name()), ID is the resource ID, LENGTH is the length of
+ * the critical section in milliseconds (including any nested critical
+ * sections), and PROBABILITY (default: 1) is the probability that a job
+ * executes the access at all. Nested accesses are carried out while the
+ * enclosing resource is held; as in the kernel, only SRP resources may be
+ * nested in SRP resources and PCP resources in PCP resources. For example,
+ *
+ *     PCP:1:0.5{PCP:2:0.1@0.5},MPCP:3:0.2
+ *
+ * locks resource 1 for 0.5ms and, in half of the jobs, additionally
+ * resource 2 for 0.1ms while holding resource 1, and later resource 3
+ * for 0.2ms.
+ */
+
+#ifndef CS_SPEC_H
+#define CS_SPEC_H
+
+#include <stdio.h>
+
+#include "litmus.h"
+
+/** Maximum number of accesses (at all nesting levels) in a specification */
+#define CS_SPEC_MAX_ACCESSES 64
+
+/**
+ * A single (possibly nested) resource access
+ */
+struct cs_access {
+	int    protocol;     /**< Locking protocol (obj_type_t) */
+	int    resource_id;  /**< Resource ID within the lock namespace */
+	double length;       /**< Critical section length in seconds */
+	double probability;  /**< Probability that a job executes the access */
+	int    first_child;  /**< Index of first nested access, or -1 */
+	int    next_sibling; /**< Index of next access at the same level, or -1 */
+	int    od;           /**< Object descriptor of the lock */
+
+	/* blocking-time statistics, in nanoseconds */
+	unsigned long count; /**< Number of times the access was executed */
+	lt_t total_blocking; /**< Sum of the blocking times */
+	lt_t max_blocking;   /**< Longest blocking time */
+	lt_t min_blocking;   /**< Shortest blocking time */
+};
+
+/**
+ * A parsed resource access specification
+ */
+struct cs_spec {
+	struct cs_access access[CS_SPEC_MAX_ACCESSES]; /**< All accesses */
+	int num_accesses; /**< Number of valid entries in access[] */
+	int first;        /**< Index of the first top-level access */
+};
+
+/**
+ * Parse a resource access specification.
+ * @param str Specification string (see above)
+ * @param spec Specification to fill in
+ * @return 0 on success, -1 (with an error message printed) otherwise
+ */
+int cs_spec_parse(const char *str, struct cs_spec *spec);
+
+/**
+ * Open the locks of all resources referenced by a specification. Each
+ * resource is opened only once, even if it is accessed several times.
+ * @param spec Parsed specification
+ * @param name_space Lock namespace file
+ * @param config_param Protocol-specific configuration (see litmus_open_lock())
+ * @return 0 on success, -1 if some lock could not be opened
+ */
+int cs_spec_open_locks(struct cs_spec *spec, const char *name_space,
+		       void *config_param);
+
+/**
+ * Record the blocking time of one execution of an access.
+ * @param access The access that was executed
+ * @param blocked Time spent in litmus_lock() in nanoseconds
+ */
+void cs_access_record(struct cs_access *access, lt_t blocked);
+
+/**
+ * Print per-access blocking statistics.
+ * @param spec Specification whose statistics to report
+ * @param out Stream to write to
+ */
+void cs_spec_report(const struct cs_spec *spec, FILE *out);
+
+#endif
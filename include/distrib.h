@@ -0,0 +1,68 @@
+/**
+ * @file distrib.h
+ * Parametric execution-time distributions for rtspin
+ *
+ * A distribution is specified as NAME:PARAM[:PARAM...], with all times in
+ * the caller's unit (rtspin uses milliseconds):
+ *
+ *     lognormal:MEAN:STDDEV               log-normal with the given moments
+ *     weibull:SHAPE:SCALE                 Weibull
+ *     bimodal:P:MEAN1:STDDEV1:MEAN2:STDDEV2
+ *                                         mixture of two normal distributions,
+ *                                         the first chosen with probability P
+ *     gumbel:LOCATION:SCALE               Gumbel (maximum), e.g., to emulate
+ *                                         the tail of a pWCET estimate
+ *
+ * Samples are drawn from a caller-provided generator (see rng.h), so that
+ * tasks seeded identically draw identical sequences. Sampling does not
+ * allocate memory.
+ */
+
+#ifndef DISTRIB_H
+#define DISTRIB_H
+
+#include "rng.h"
+
+/** Supported distribution families */
+enum distrib_type {
+	DISTRIB_LOGNORMAL,
+	DISTRIB_WEIBULL,
+	DISTRIB_BIMODAL,
+	DISTRIB_GUMBEL,
+};
+
+/** Maximum number of parameters of any distribution */
+#define DISTRIB_MAX_PARAMS 5
+
+/**
+ * A parametric distribution
+ */
+struct distrib {
+	enum distrib_type type;              /**< Distribution family */
+	double param[DISTRIB_MAX_PARAMS];    /**< Family-specific parameters */
+};
+
+/**
+ * Parse a distribution specification (see above).
+ * @param spec Specification string
+ * @param dist Distribution to initialize
+ * @return 0 on success, -1 if the specification is invalid
+ */
+int distrib_parse(const char *spec, struct distrib *dist);
+
+/**
+ * Draw a sample. Negative samples (possible with bimodal) are clamped to 0.
+ * @param dist Distribution
+ * @param rng Generator to draw from
+ * @return Sample in the unit of the specification's parameters
+ */
+double distrib_sample(const struct distrib *dist, struct rng *rng);
+
+/**
+ * Mean of a distribution, without clamping.
+ * @param dist Distribution
+ * @return Expected value of a sample
+ */
+double distrib_mean(const struct distrib *dist);
+
+#endif
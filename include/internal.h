@@ -26,7 +26,86 @@
 /* I/O convenience function */
 ssize_t read_file(const char* fname, void* buf, size_t maxlen);
 
+/* Files that are queried repeatedly (e.g., in /proc/litmus) can be kept
+ * open: a handle is re-read from the start on every read_file_handle(),
+ * which costs one system call instead of three. */
+int open_file_handle(const char* fname);
+ssize_t read_file_handle(int handle, void* buf, size_t maxlen);
+void close_file_handle(int handle);
+/* open *handle (initially -1) on first use, shared by all threads */
+int cached_file_handle(int *handle, const char* fname);
+
 long litmus_syscall(litmus_syscall_id_t syscall, unsigned long arg);
 
+/* cache of open lock namespace files; the fd must be returned with
+ * put_namespace_fd(). *dev and *ino identify the file. */
+int get_namespace_fd(const char *namespace, int *cached,
+		     dev_t *dev, ino_t *ino);
+void put_namespace_fd(int fd, int cached);
+void close_namespaces(void);
+
+/* userspace fast path of FMLP semaphores (see litmus_open_fast_lock()) */
+volatile uint32_t *fast_lock_word(int od);
+int fast_lock_user_held(void);
+void fast_lock_forget(int od);
+int fast_lock(int od, volatile uint32_t *word);
+int fast_unlock(int od, volatile uint32_t *word);
+
+/* Per-thread records that must outlive their threads (e.g., statistics that
+ * exit_litmus() reports) start with a struct thread_record and are pushed
+ * onto a process-wide list, which is only ever taken as a whole. */
+struct thread_record {
+	struct thread_record *next;
+	pid_t tid;
+};
+
+static inline void thread_record_add(struct thread_record **list,
+				     struct thread_record *r)
+{
+	r->tid = gettid();
+	do
+		r->next = *list;
+	while (!__sync_bool_compare_and_swap(list, r->next, r));
+}
+
+static inline struct thread_record *thread_record_take(
+	struct thread_record **list)
+{
+	return __sync_lock_test_and_set(list, NULL);
+}
+
+/* logarithmic histogram bucket: bucket i counts values in [2^i, 2^(i+1)),
+ * the last of num_buckets also everything above (bucket 0 also counts 0) */
+static inline int log2_bucket(uint64_t v, int num_buckets)
+{
+	int b;
+
+	if (v < 2)
+		return 0;
+	b = 63 - __builtin_clzll((unsigned long long) v);
+	return b < num_buckets ? b : num_buckets - 1;
+}
+
+/* lock statistics (see litmus_lock_stats_enable()); compiled out of the lock
+ * wrappers with -DLITMUS_NO_LOCK_STATS */
+extern int lock_stats_enabled;
+
+void lock_stats_init(void);
+void lock_stats_exit(void);
+void lock_stats_locked(int od, int ret, cycles_t start, cycles_t end);
+void lock_stats_unlocked(int od, int ret, cycles_t end);
+
+/* per-job interrupt statistics (see litmus_irq_job_begin()) */
+void irq_stats_init(void);
+void irq_stats_exit(void);
+
+/* od_openx() for a namespace file whose device and inode are known */
+int od_open_keyed(int fd, obj_type_t type, int obj_id, void *config,
+		  dev_t dev, ino_t ino);
+
+/* acquisition order of locks for litmus_lock_group() */
+void lock_group_remember(int od, dev_t dev, ino_t ino, int obj_id);
+void lock_group_forget(int od);
+
 #endif
 
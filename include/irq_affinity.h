@@ -0,0 +1,106 @@
+/**
+ * @file irq_affinity.h
+ * Steering device interrupts away from real-time partitions
+ *
+ * Device interrupts are spread over all CPUs by default, where they delay
+ * real-time tasks. These functions read the per-CPU interrupt counts from
+ * /proc/interrupts and change the affinities in /proc/irq/N/smp_affinity
+ * so that interrupts are handled on CPUs that run no real-time tasks,
+ * e.g., the release master. Like domain_to_cpus(), CPU sets are bit masks
+ * and limited to 64 CPUs.
+ *
+ * All files are looked up below a configurable procfs root, so that the
+ * functions can be tried on a copy of (or a made-up) procfs.
+ */
+
+#ifndef IRQ_AFFINITY_H
+#define IRQ_AFFINITY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Largest CPU set supported (bits of the masks) */
+#define IRQ_MAX_CPUS 64
+
+/**
+ * Look up the files of all following calls below another root.
+ * @param root Directory that takes the place of /proc (NULL for /proc)
+ * @return 0 on success, -1 (with errno set to ENAMETOOLONG) if the path is
+ *         too long
+ */
+int irq_set_proc_root(const char *root);
+
+/**
+ * Read the number of interrupts handled by each CPU so far.
+ * @param device Receives the per-CPU counts of device interrupts (numbered
+ *        lines of /proc/interrupts), indexed by CPU; may be NULL
+ * @param all Receives the per-CPU counts of all interrupts, including
+ *        architecture-specific ones such as local timer interrupts; may be
+ *        NULL
+ * @param max_cpus Number of entries of the arrays
+ * @return One more than the highest CPU listed (entries beyond that are
+ *         zero), or -1 if /proc/interrupts cannot be read or parsed
+ */
+int irq_read_counts(unsigned long long *device, unsigned long long *all,
+		    int max_cpus);
+
+/**
+ * List the numbered (device) interrupts of /proc/interrupts.
+ * @param irqs Receives the interrupt numbers
+ * @param max_irqs Number of entries of irqs
+ * @return Number of interrupts stored, or -1 on error
+ */
+int irq_list(int *irqs, int max_irqs);
+
+/**
+ * Get the CPUs an interrupt may be handled on.
+ * @param irq Interrupt number
+ * @param mask Receives the CPU set
+ * @return 0 on success, -1 on error
+ */
+int irq_get_affinity(int irq, unsigned long long *mask);
+
+/**
+ * Set the CPUs an interrupt may be handled on.
+ * @param irq Interrupt number
+ * @param mask CPU set (must not be empty)
+ * @return 0 on success, -1 on error (some interrupts, e.g., per-CPU ones,
+ *         cannot be moved)
+ */
+int irq_set_affinity(int irq, unsigned long long mask);
+
+/**
+ * Determine the CPUs that run real-time tasks: the CPUs of all scheduling
+ * domains (domain_to_cpus()), except the release master (release_master()).
+ * These are read from the real /proc/litmus, not below the procfs root.
+ * @param rt Receives the real-time CPUs
+ * @param housekeeping Receives the CPUs that interrupts should be steered
+ *        to: the release master if there is one, otherwise all online CPUs
+ *        without real-time tasks (may be empty)
+ * @return 0 on success, -1 if the domains cannot be read (e.g., without an
+ *         active LITMUS^RT plugin)
+ */
+int irq_rt_cpus(unsigned long long *rt, unsigned long long *housekeeping);
+
+/**
+ * Remove the real-time CPUs from the affinity of every device interrupt;
+ * interrupts allowed on real-time CPUs only are moved to the housekeeping
+ * CPUs. Interrupts that cannot be moved are skipped.
+ * @param rt Real-time CPUs
+ * @param housekeeping CPUs to handle interrupts that have no other CPU
+ *        left (must not be empty)
+ * @param moved Receives the number of changed affinities; may be NULL
+ * @param failed Receives the number of interrupts that could not be
+ *        changed; may be NULL
+ * @return 0 on success, -1 if the interrupts cannot be listed or the
+ *         housekeeping set is empty
+ */
+int irq_steer_away(unsigned long long rt, unsigned long long housekeeping,
+		   int *moved, int *failed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file job_trace.h
+ * Compact binary workload traces for rtspin
+ *
+ * A job trace consists of a fixed-size header followed by an array of
+ * fixed-width records, one per job. All values are stored in host byte order
+ * and all times are given in nanoseconds. Traces are created from CSV files
+ * with csv2trace and mapped directly into memory by rtspin, so that loading a
+ * trace does not depend on its length and looking up the next job is a
+ * pointer increment.
+ */
+
+#ifndef JOB_TRACE_H
+#define JOB_TRACE_H
+
+#include <stdint.h>
+
+/** Magic string at the start of every job trace (not NUL-terminated) */
+#define JOB_TRACE_MAGIC "LTJTRACE"
+/** Current version of the trace format */
+#define JOB_TRACE_VERSION 1
+/** Value of job_trace_header::byte_order as written by this host */
+#define JOB_TRACE_BYTE_ORDER 0x01020304
+
+/** The inter_arrival_ns field of each record is valid */
+#define JOB_TRACE_HAS_ARRIVALS    (1 << 0)
+/** The cs_length_ns and resource_id fields of each record are valid */
+#define JOB_TRACE_HAS_LOCKS       (1 << 1)
+/** The suspension_ns field of each record is valid */
+#define JOB_TRACE_HAS_SUSPENSIONS (1 << 2)
+
+/**
+ * File header of a job trace
+ */
+struct job_trace_header {
+	char     magic[8];    /**< JOB_TRACE_MAGIC */
+	uint32_t version;     /**< JOB_TRACE_VERSION */
+	uint32_t record_size; /**< sizeof(struct job_trace_record) */
+	uint32_t byte_order;  /**< JOB_TRACE_BYTE_ORDER */
+	uint32_t flags;       /**< Which optional fields are valid */
+	uint64_t num_records; /**< Number of records following the header */
+};
+
+/**
+ * Description of a single job
+ */
+struct job_trace_record {
+	uint64_t exec_ns;          /**< Execution time of the job */
+	uint64_t inter_arrival_ns; /**< Delay until the next job is released */
+	uint64_t cs_length_ns;     /**< Length of the critical section */
+	uint64_t suspension_ns;    /**< Length of the self-suspension */
+	int32_t  resource_id;      /**< Resource accessed, -1 for none */
+	uint32_t reserved;         /**< Padding, must be zero */
+};
+
+/**
+ * A job trace mapped into memory
+ */
+struct job_trace {
+	const struct job_trace_header *hdr; /**< Start of the mapping */
+	const struct job_trace_record *begin; /**< First record */
+	const struct job_trace_record *end; /**< One past the last record */
+	const struct job_trace_record *next; /**< Record of the next job */
+	size_t map_size; /**< Size of the mapping in bytes */
+};
+
+/**
+ * Map a job trace file into memory and validate its header.
+ * @param file Path of the trace file
+ * @param trace Trace to initialize
+ * @return 0 on success, -1 (with an error message printed) otherwise
+ */
+int job_trace_open(const char *file, struct job_trace *trace);
+
+/**
+ * Unmap a job trace previously mapped with job_trace_open().
+ * @param trace Trace to release
+ */
+void job_trace_close(struct job_trace *trace);
+
+/**
+ * Write a job trace file.
+ * @param file Path of the file to create (or truncate)
+ * @param records Array of job records
+ * @param num_records Number of records
+ * @param flags Which optional fields of the records are valid
+ * @return 0 on success, -1 otherwise
+ */
+int job_trace_write(const char *file, const struct job_trace_record *records,
+		    uint64_t num_records, uint32_t flags);
+
+/**
+ * Total time spanned by the jobs of a trace, i.e., the sum of the
+ * inter-arrival times of all records.
+ * @param trace A mapped trace with JOB_TRACE_HAS_ARRIVALS set
+ * @return Span of the trace in nanoseconds
+ */
+uint64_t job_trace_span_ns(const struct job_trace *trace);
+
+/**
+ * Return the record of the next job. Wraps around at the end of the trace.
+ * @param trace A trace with at least one record
+ * @return Pointer into the mapped trace
+ */
+static inline const struct job_trace_record* job_trace_next(
+	struct job_trace *trace)
+{
+	const struct job_trace_record *rec = trace->next++;
+	if (trace->next == trace->end)
+		trace->next = trace->begin;
+	return rec;
+}
+
+/**
+ * Number of records in a mapped job trace.
+ * @param trace A mapped trace
+ * @return Number of job records
+ */
+static inline uint64_t job_trace_length(const struct job_trace *trace)
+{
+	return trace->hdr->num_records;
+}
+
+#endif
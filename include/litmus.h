@@ -29,6 +29,7 @@ extern "C" {
 
 #include <sys/types.h>
 #include <stdint.h>
+#include <stdio.h>
 
 /* Include kernel header.
  * This is required for the rt_param
@@ -39,7 +40,7 @@ extern "C" {
 #include "litmus/ctrlpage.h"
 #undef __user
 
-#include "asm/cycles.h" /* for null_call() */
+#include "asm/cycles.h" /* for null_call() and lock statistics */
 
 #include "migration.h"
 
@@ -216,7 +217,8 @@ static inline int od_open(int fd, obj_type_t type, int obj_id)
 
 /**
  * public:
- * Open a lock, mark it used by the invoking thread
+ * Open a lock, mark it used by the invoking thread. The namespace file is
+ * kept open (until exit_litmus()) for subsequent locks in the same namespace.
  * @param protocol Desired locking protocol
  * @param lock_id Name of the lock, user-specified numerical id
  * @param name_space Path to a shared file
@@ -227,6 +229,49 @@ static inline int od_open(int fd, obj_type_t type, int obj_id)
 int litmus_open_lock(obj_type_t protocol, int lock_id, const char* name_space,
 		void *config_param);
 
+/**
+ * Open several locks of the same protocol in one namespace. The namespace
+ * file is opened at most once (and kept open until exit_litmus()), as
+ * with litmus_open_lock(), and checked for having been re-created only once
+ * per call, so opening many locks in one batch is cheaper than one by one.
+ * @param protocol Desired locking protocol
+ * @param lock_ids Names of the locks, user-specified numerical ids
+ * @param num_locks Number of entries in lock_ids
+ * @param name_space Path to a shared file
+ * @param config_param Any extra info needed by the protocol (like CPU for SRP
+ * or PCP), may be NULL
+ * @param ods Array of num_locks entries that receives the object descriptors
+ * @return 0 if all locks were opened, -1 otherwise (in which case none
+ * remain open)
+ */
+int litmus_open_locks(obj_type_t protocol, const int *lock_ids, int num_locks,
+		const char* name_space, void *config_param, int *ods);
+
+/**
+ * Open a lock with a userspace fast path. Uncontended acquisitions and
+ * releases of the lock do not enter the kernel; the critical sections of
+ * tasks that acquire the lock this way are executed non-preemptively. Under
+ * contention, the kernel protocol is used. The fast path is supported only
+ * for FMLP semaphores, and only real-time tasks whose critical sections do
+ * not suspend may use it.
+ *
+ * The lock words are kept in a shared memory object of the namespace (in
+ * /dev/shm), not in the namespace file. Every task that uses a semaphore
+ * with the fast path must open it with this function: tasks that open it
+ * with litmus_open_lock(), od_open(), etc. do not see the lock word and are
+ * not mutually excluded with userspace holders. As with the kernel
+ * protocol, a task may not lock a fast-path semaphore while holding another
+ * lock, or any lock while holding one (litmus_lock() fails with EBUSY).
+ * @param protocol Desired locking protocol (must be FMLP_SEM)
+ * @param lock_id Name of the lock, user-specified numerical id
+ * @param name_space Path to a shared file
+ * @param config_param Any extra info needed by the protocol, may be NULL
+ * @return Object descriptor for this lock, or -1 (with errno set to EINVAL
+ * if the protocol does not support the fast path)
+ */
+int litmus_open_fast_lock(obj_type_t protocol, int lock_id,
+		const char* name_space, void *config_param);
+
 /**
  * Obtain lock
  * @param od Object descriptor obtained by litmus_open_lock()
@@ -240,6 +285,197 @@ int litmus_lock(int od);
  */
 int litmus_unlock(int od);
 
+/** Maximum number of locks in a group */
+#define LITMUS_MAX_LOCK_GROUP 16
+
+/**
+ * Obtain several locks. The locks are acquired in a global order (by
+ * namespace file and lock id, recorded when the locks are opened), so that
+ * tasks acquiring overlapping groups with this function cannot deadlock.
+ * The kernel must permit the protocols involved to be nested (e.g., the
+ * PCP). If any lock cannot be obtained, the locks acquired so far are
+ * released again. Fails with EINVAL for descriptors whose order could not be
+ * recorded when they were opened.
+ * @param ods Object descriptors of the locks, in any order, without duplicates
+ * @param num_ods Number of locks (at most LITMUS_MAX_LOCK_GROUP)
+ * @return 0 iff all locks were obtained
+ */
+int litmus_lock_group(const int *ods, int num_ods);
+
+/**
+ * Release a group of locks obtained with litmus_lock_group(), in reverse
+ * acquisition order. All locks are released even if one release fails.
+ * @param ods Object descriptors of the locks, in any order
+ * @param num_ods Number of locks
+ * @return 0 iff all locks were released
+ */
+int litmus_unlock_group(const int *ods, int num_ods);
+
+/***** lock statistics *****/
+
+/** Number of (logarithmic) histogram buckets of struct litmus_lock_stats */
+#define LITMUS_LOCK_STATS_BUCKETS 32
+/** Object descriptors beyond this limit are not accounted */
+#define LITMUS_LOCK_STATS_MAX_OD 128
+
+/**
+ * Blocking and hold times of one lock, in cycles. Bucket i of a histogram
+ * counts times in [2^i, 2^(i+1)); the last bucket also counts longer times.
+ */
+struct litmus_lock_stats {
+	uint64_t acquisitions;   /**< Successful litmus_lock() calls */
+	uint64_t failures;       /**< Failed litmus_lock() calls */
+	cycles_t wait_total;     /**< Sum of litmus_lock() durations */
+	cycles_t wait_max;       /**< Longest litmus_lock() duration */
+	cycles_t hold_total;     /**< Sum of times from acquisition to release */
+	cycles_t hold_max;       /**< Longest time from acquisition to release */
+	uint64_t wait_hist[LITMUS_LOCK_STATS_BUCKETS]; /**< Lock durations */
+	uint64_t hold_hist[LITMUS_LOCK_STATS_BUCKETS]; /**< Hold times */
+};
+
+/**
+ * Enable or disable the accounting of blocking and hold times in
+ * litmus_lock() and litmus_unlock() for all threads. Statistics are kept
+ * per thread and object descriptor, and are not reset when a lock is
+ * closed. Setting the environment variable LITMUS_LOCK_STATS (to anything
+ * but 0) enables the accounting in init_rt_thread() and prints the
+ * statistics of every thread, including threads that have already exited,
+ * in exit_litmus(), which also frees them. The accounting can be compiled
+ * out of the library with -DLITMUS_NO_LOCK_STATS.
+ * @param enable Non-zero to enable, 0 to disable
+ */
+void litmus_lock_stats_enable(int enable);
+
+/**
+ * Get the statistics of the calling thread for a lock.
+ * @param od Object descriptor of the lock
+ * @param stats Receives the statistics (all zero if nothing was recorded)
+ * @return 0 on success, -1 (with errno set to EINVAL) if od is not accounted
+ */
+int litmus_lock_stats_get(int od, struct litmus_lock_stats *stats);
+
+/**
+ * Clear all statistics of the calling thread.
+ */
+void litmus_lock_stats_reset(void);
+
+/**
+ * Accumulate statistics, e.g., of several threads or locks.
+ * @param into Statistics to add to
+ * @param from Statistics to add
+ */
+void litmus_lock_stats_merge(struct litmus_lock_stats *into,
+		const struct litmus_lock_stats *from);
+
+/**
+ * Print statistics in human-readable form.
+ * @param out Stream to print to
+ * @param label Prefix of the summary line
+ * @param stats Statistics to print
+ */
+void litmus_lock_stats_print(FILE *out, const char *label,
+		const struct litmus_lock_stats *stats);
+
+/**
+ * Print the statistics of all locks used by the calling thread.
+ * @param out Stream to print to
+ */
+void litmus_lock_stats_dump(FILE *out);
+
+/***** interrupt interference *****/
+
+/** Number of histogram buckets of struct litmus_irq_stats */
+#define LITMUS_IRQ_STATS_BUCKETS 32
+
+/**
+ * Interrupts suffered by the jobs of a task and the resulting inflation of
+ * their execution times (thread CPU time), in nanoseconds. On kernels with
+ * CONFIG_IRQ_TIME_ACCOUNTING, the time spent in interrupt handlers is not
+ * charged to the thread, so the inflation reflects only their indirect
+ * cost (e.g., cache misses afterwards). Bucket i of
+ * irq_hist counts jobs with i interrupts; bucket i of inflation_hist counts
+ * jobs whose inflation per interrupt was in [2^i, 2^(i+1)). The last bucket
+ * of either histogram also counts larger values. Only jobs whose expected
+ * execution time was given are included in the inflation statistics.
+ */
+struct litmus_irq_stats {
+	uint64_t jobs;               /**< Jobs accounted */
+	uint64_t jobs_with_irqs;     /**< Jobs that suffered any interrupt */
+	uint64_t irqs;               /**< Interrupts suffered by all jobs */
+	uint64_t max_irqs;           /**< Most interrupts suffered by one job */
+	lt_t exec_total;             /**< Sum of execution times */
+	uint64_t timed_jobs;         /**< Jobs with an expected execution time */
+	uint64_t timed_irqs;         /**< Interrupts suffered by these jobs */
+	lt_t inflation_total;        /**< Sum of inflations */
+	lt_t inflation_max;          /**< Largest inflation */
+	double sum_irqs_sq;          /**< Sum of squared interrupt counts */
+	double sum_irqs_inflation;   /**< Sum of interrupts times inflation */
+	double sum_inflation_sq;     /**< Sum of squared inflations */
+	uint64_t irq_hist[LITMUS_IRQ_STATS_BUCKETS];       /**< IRQs per job */
+	uint64_t inflation_hist[LITMUS_IRQ_STATS_BUCKETS]; /**< Per IRQ */
+};
+
+/**
+ * Mark the release of a job of the calling thread: sample the interrupt
+ * count of its control page and its CPU time. Setting the environment
+ * variable LITMUS_IRQ_STATS (to anything but 0) prints the statistics of
+ * every thread, including threads that have already exited, in
+ * exit_litmus().
+ * @return 0 on success, -1 (with errno set to ENODEV) if the thread has no
+ *         control page
+ */
+int litmus_irq_job_begin(void);
+
+/**
+ * Mark the completion of the job started with litmus_irq_job_begin() and
+ * account its interrupts and execution time.
+ * @param expected_exec Execution time of the job without interference, in
+ *        ns, or 0 if unknown (the job then does not count towards the
+ *        inflation statistics)
+ * @return 0 on success, -1 (with errno set to ENODEV or EINVAL) if there is
+ *         no control page or no job was started
+ */
+int litmus_irq_job_end(lt_t expected_exec);
+
+/**
+ * Get the interrupt statistics of the calling thread.
+ * @param stats Receives the statistics
+ */
+void litmus_irq_stats_get(struct litmus_irq_stats *stats);
+
+/**
+ * Clear the interrupt statistics of the calling thread.
+ */
+void litmus_irq_stats_reset(void);
+
+/**
+ * Accumulate interrupt statistics, e.g., of all tasks of a partition.
+ * @param into Statistics to add to
+ * @param from Statistics to add
+ */
+void litmus_irq_stats_merge(struct litmus_irq_stats *into,
+		const struct litmus_irq_stats *from);
+
+/**
+ * Fit the inflation of jobs to their interrupt counts (least squares).
+ * @param stats Statistics to evaluate
+ * @param per_irq Receives the inflation per interrupt in ns
+ * @param r2 Receives the coefficient of determination (0 to 1)
+ * @return 0 on success, -1 if the interrupt counts of the timed jobs do not
+ *         vary
+ */
+int litmus_irq_stats_fit(const struct litmus_irq_stats *stats,
+		double *per_irq, double *r2);
+
+/**
+ * Print interrupt statistics in human-readable form.
+ * @param out Stream to print to
+ * @param label Prefix of the summary line
+ * @param stats Statistics to print
+ */
+void litmus_irq_stats_print(FILE *out, const char *label,
+		const struct litmus_irq_stats *stats);
+
 /***** job control *****/
 /**
  * @todo Doxygen
@@ -266,7 +502,8 @@ int  init_litmus(void);
  */
 int  init_rt_thread(void);
 /**
- * Cleans up real-time properties for the entire program
+ * Cleans up real-time properties for the entire program. Must be called
+ * after the other threads have stopped using the library.
  */
 void exit_litmus(void);
 
@@ -0,0 +1,94 @@
+/**
+ * @file rng.h
+ * Small, fast pseudo-random number generator with explicit state
+ *
+ * The generator is xoshiro256** (Blackman and Vigna), seeded through
+ * splitmix64. Unlike rand() and drand48(), all state is kept in a
+ * caller-provided struct rng, so each task or thread can own an independent
+ * generator, and identical seeds reproduce identical sequences.
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/**
+ * Generator state
+ */
+struct rng {
+	uint64_t s[4];
+};
+
+static inline uint64_t rng_rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * Seed a generator. Generators seeded with the same seed, but different
+ * stream numbers, produce unrelated sequences.
+ * @param rng Generator to seed
+ * @param seed Seed value
+ * @param stream Stream number (e.g., a thread index)
+ */
+static inline void rng_seed(struct rng *rng, uint64_t seed, uint64_t stream)
+{
+	uint64_t x = seed ^ rng_splitmix64(&stream);
+	int i;
+
+	for (i = 0; i < 4; i++)
+		rng->s[i] = rng_splitmix64(&x);
+}
+
+/**
+ * Next 64-bit output of a generator.
+ * @param rng Generator
+ * @return Uniformly distributed 64-bit value
+ */
+static inline uint64_t rng_next(struct rng *rng)
+{
+	uint64_t *s = rng->s;
+	uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rng_rotl(s[3], 45);
+
+	return result;
+}
+
+/**
+ * Uniformly distributed double in [0, 1), a replacement for drand48().
+ * @param rng Generator
+ * @return Random value in [0, 1)
+ */
+static inline double rng_uniform(struct rng *rng)
+{
+	return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Uniformly distributed integer in [0, n), a replacement for lrand48() % n.
+ * @param rng Generator
+ * @param n Upper bound (exclusive), must be positive
+ * @return Random value in [0, n)
+ */
+static inline uint32_t rng_below(struct rng *rng, uint32_t n)
+{
+	return (uint32_t) (((rng_next(rng) >> 32) * n) >> 32);
+}
+
+#endif
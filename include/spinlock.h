@@ -0,0 +1,108 @@
+/**
+ * @file spinlock.h
+ * Userspace spin locks with non-preemptive critical sections
+ *
+ * The locks follow the MSRP: a task becomes non-preemptive (enter_np())
+ * before it requests a lock, spins non-preemptively until it is granted in
+ * FIFO order, and becomes preemptive again when it releases the lock
+ * (exit_np()). Neither acquisition nor release enters the kernel, which
+ * makes these locks suitable for critical sections too short to amortize
+ * the system calls of the suspension-based protocols. Since spinning and
+ * critical sections are non-preemptive, both should be short, and
+ * critical sections must not suspend.
+ *
+ * The locks contain no pointers and can be placed in memory shared among
+ * processes (e.g., a MAP_SHARED mapping), at any address in each process.
+ */
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Size of a cache line, to keep lock words of different tasks apart */
+#define LITMUS_CACHE_LINE 64
+
+/**
+ * FIFO ticket lock. All waiters spin on the same word, which is cheap for
+ * few contending processors.
+ */
+struct litmus_ticket_lock {
+	volatile uint32_t next;     /**< Next ticket to hand out */
+	volatile uint32_t owner;    /**< Ticket currently granted the lock */
+} __attribute__((aligned(LITMUS_CACHE_LINE)));
+
+/**
+ * Initialize a ticket lock (before any task uses it).
+ * @param lock Lock to initialize
+ */
+void litmus_ticket_init(struct litmus_ticket_lock *lock);
+
+/**
+ * Become non-preemptive and acquire a ticket lock.
+ * @param lock Lock to acquire
+ */
+void litmus_ticket_lock(struct litmus_ticket_lock *lock);
+
+/**
+ * Release a ticket lock and become preemptive again.
+ * @param lock Lock to release
+ */
+void litmus_ticket_unlock(struct litmus_ticket_lock *lock);
+
+/** Queue node of one task in an MCS lock */
+struct litmus_mcs_node {
+	volatile uint32_t next;     /**< Successor's slot + 1, 0 if none */
+	volatile uint32_t locked;   /**< Set while the owner must wait */
+} __attribute__((aligned(LITMUS_CACHE_LINE)));
+
+/**
+ * FIFO queue (MCS) lock. Each waiter spins on its own node, so that a
+ * release invalidates only the successor's cache line. Since pointers are
+ * meaningless across processes, every task that uses the lock is assigned
+ * a slot (0 <= slot < num_slots), which selects its node.
+ */
+struct litmus_mcs_lock {
+	volatile uint32_t tail;     /**< Last waiter's slot + 1, 0 if free */
+	uint32_t num_slots;         /**< Number of nodes */
+	struct litmus_mcs_node node[]; /**< One node per slot */
+} __attribute__((aligned(LITMUS_CACHE_LINE)));
+
+/**
+ * Size of an MCS lock with the given number of slots.
+ * @param num_slots Number of tasks that may use the lock
+ * @return Number of bytes to allocate for the lock
+ */
+size_t litmus_mcs_size(int num_slots);
+
+/**
+ * Initialize an MCS lock (before any task uses it).
+ * @param lock Lock to initialize, of at least litmus_mcs_size(num_slots) bytes
+ * @param num_slots Number of tasks that may use the lock
+ */
+void litmus_mcs_init(struct litmus_mcs_lock *lock, int num_slots);
+
+/**
+ * Become non-preemptive and acquire an MCS lock.
+ * @param lock Lock to acquire
+ * @param slot Slot of the calling task; no two tasks may use the same slot
+ */
+void litmus_mcs_lock(struct litmus_mcs_lock *lock, int slot);
+
+/**
+ * Release an MCS lock and become preemptive again.
+ * @param lock Lock to release
+ * @param slot Slot passed to litmus_mcs_lock()
+ */
+void litmus_mcs_unlock(struct litmus_mcs_lock *lock, int slot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,275 @@
+/* Userspace fast path for uncontended suspension-based locks.
+ *
+ * The lock words of the FMLP semaphores in a namespace live in a shared
+ * memory object of their own (/dev/shm/litmus-fastlock-DEV-INO, after the
+ * device and inode of the namespace file), at offset lock_id * 4; the
+ * namespace file itself is left alone. Only tasks that open a semaphore with
+ * litmus_open_fast_lock() use the object. Each 32-bit word encodes
+ *
+ *   lower 22 bits         the thread ID of a task that holds the lock in
+ *                         userspace, without the kernel knowing about it,
+ *                         or 0 (thread IDs are below 2^22, see pid_max);
+ *   upper 10 bits         the number of tasks that are currently in (or
+ *                         holding the lock through) the kernel protocol.
+ *
+ * A task acquires the lock in userspace only if the word is 0. Since the
+ * kernel cannot apply progress mechanisms (e.g., priority inheritance) to a
+ * holder it does not know about, userspace holders execute their critical
+ * sections non-preemptively. A task that finds the lock taken registers
+ * itself in the word and falls back to the kernel protocol; after obtaining
+ * the kernel lock, it waits non-preemptively for a remaining userspace
+ * holder to leave, which is bounded by the length of one (non-preemptive)
+ * critical section. The protocol's analysis is therefore that of the FMLP
+ * with one additional non-preemptive blocking term, which is why only FMLP
+ * semaphores support the fast path.
+ *
+ * Stale state is recovered as follows. Every task keeps a shared flock() on
+ * the object while it uses it; a task that creates (or reopens) the object
+ * and can lock it exclusively knows that no task uses it and clears it,
+ * which discards the words left by tasks that were killed. While the object
+ * is in use, a waiter that finds the userspace holder dead releases the
+ * word on its behalf. A task that is killed on the kernel path leaves its
+ * count behind, which keeps the other tasks on the (correct, but slower)
+ * kernel path until the object is cleared.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "litmus.h"
+#include "internal.h"
+
+#define FAST_LOCK_HOLDER  0x003fffffU
+#define FAST_LOCK_KERNEL  0x00400000U  /* one task on the kernel path */
+
+struct fast_od {
+	volatile uint32_t *word;
+	int fd;         /* of the lock word object, holds the shared flock() */
+	int held;       /* held through the userspace path */
+};
+
+/* Object descriptors are per-task (i.e., per-thread) indices, and so are
+ * the tables of lock words; they grow with the highest descriptor used. */
+static __thread struct fast_od *fast_ods;
+static __thread int num_fast_ods;
+/* whether this thread holds a lock through the userspace path */
+static __thread int user_held;
+
+static struct fast_od *get_fast_od(int od)
+{
+	struct fast_od *table;
+	int n;
+
+	if (od < num_fast_ods)
+		return fast_ods + od;
+
+	for (n = num_fast_ods ? num_fast_ods : 16; n <= od; n *= 2)
+		;
+	table = realloc(fast_ods, n * sizeof(*table));
+	if (!table)
+		return NULL;
+	memset(table + num_fast_ods, 0,
+	       (n - num_fast_ods) * sizeof(*table));
+	fast_ods = table;
+	num_fast_ods = n;
+	return fast_ods + od;
+}
+
+volatile uint32_t *fast_lock_word(int od)
+{
+	if (od < 0 || od >= num_fast_ods)
+		return NULL;
+	return fast_ods[od].word;
+}
+
+int fast_lock_user_held(void)
+{
+	return user_held;
+}
+
+/* Open the lock word object of a namespace, with a shared flock() held. */
+static int open_word_object(dev_t dev, ino_t ino)
+{
+	char path[64];
+	int fd;
+
+	snprintf(path, sizeof(path), "/dev/shm/litmus-fastlock-%llx-%llx",
+		 (unsigned long long) dev, (unsigned long long) ino);
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		return -1;
+
+	/* nobody else uses the object: whatever it holds is stale */
+	if (flock(fd, LOCK_EX | LOCK_NB) == 0 && ftruncate(fd, 0) != 0) {
+		close(fd);
+		return -1;
+	}
+	if (flock(fd, LOCK_SH) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static volatile uint32_t *map_lock_word(int fd, int lock_id)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	off_t offset = (off_t) lock_id * sizeof(uint32_t);
+	off_t page = offset - offset % page_size;
+	char *mapped;
+	int err;
+
+	/* never shrink the object, other tasks may have mapped words beyond */
+	err = posix_fallocate(fd, 0, page + page_size);
+	if (err) {
+		errno = err;
+		return NULL;
+	}
+
+	mapped = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		      fd, page);
+	if (mapped == MAP_FAILED)
+		return NULL;
+	return (volatile uint32_t *) (mapped + (offset - page));
+}
+
+static int fast_lock_attach(int od, dev_t dev, ino_t ino, int lock_id)
+{
+	struct fast_od *f = get_fast_od(od);
+
+	if (!f)
+		return -1;
+
+	f->fd = open_word_object(dev, ino);
+	if (f->fd < 0)
+		return -1;
+	f->word = map_lock_word(f->fd, lock_id);
+	if (!f->word) {
+		close(f->fd);
+		return -1;
+	}
+	f->held = 0;
+	return 0;
+}
+
+int litmus_open_fast_lock(
+	obj_type_t protocol,
+	int lock_id,
+	const char* namespace,
+	void *config_param)
+{
+	int fd, od, cached, err;
+	dev_t dev;
+	ino_t ino;
+
+	if (protocol != FMLP_SEM || lock_id < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = get_namespace_fd(namespace, &cached, &dev, &ino);
+	if (fd < 0)
+		return -1;
+
+	od = od_open_keyed(fd, protocol, lock_id, config_param, dev, ino);
+	if (od >= 0 && fast_lock_attach(od, dev, ino, lock_id) != 0) {
+		err = errno;
+		od_close(od);
+		errno = err;
+		od = -1;
+	}
+
+	put_namespace_fd(fd, cached);
+	return od;
+}
+
+void fast_lock_forget(int od)
+{
+	long page_size;
+
+	if (!fast_lock_word(od))
+		return;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	munmap((void *) ((uintptr_t) fast_ods[od].word & ~(page_size - 1)),
+	       page_size);
+	close(fast_ods[od].fd);
+	fast_ods[od].word = NULL;
+	fast_ods[od].held = 0;
+}
+
+/* Wait for the userspace holder (if any) to leave, or release the word on
+ * its behalf if it has died. */
+static void wait_for_user_holder(volatile uint32_t *word)
+{
+	uint32_t old;
+	pid_t holder;
+
+	while ((holder = (old = *word) & FAST_LOCK_HOLDER)) {
+		if (kill(holder, 0) != 0 && errno == ESRCH)
+			__sync_bool_compare_and_swap(word, old,
+						     old & ~FAST_LOCK_HOLDER);
+		__sync_synchronize();
+	}
+}
+
+int fast_lock(int od, volatile uint32_t *word)
+{
+	long ret;
+
+	/* uncontended case: become non-preemptive and take the word */
+	if (likely(get_ctrl_page() != NULL)) {
+		enter_np();
+		if (!*word && __sync_bool_compare_and_swap(word, 0,
+				(uint32_t) gettid() & FAST_LOCK_HOLDER)) {
+			fast_ods[od].held = 1;
+			user_held = 1;
+			return 0;
+		}
+		exit_np();
+	}
+
+	/* contended case: keep new tasks off the fast path and queue up in
+	 * the kernel */
+	__sync_fetch_and_add(word, FAST_LOCK_KERNEL);
+	ret = litmus_syscall(LRT_litmus_lock, od);
+	if (ret != 0) {
+		__sync_fetch_and_sub(word, FAST_LOCK_KERNEL);
+		return ret;
+	}
+
+	/* the holder runs non-preemptively, and so does the wait for it,
+	 * which keeps the blocking bounded by one critical section */
+	enter_np();
+	wait_for_user_holder(word);
+	exit_np();
+
+	return 0;
+}
+
+int fast_unlock(int od, volatile uint32_t *word)
+{
+	long ret;
+
+	if (fast_ods[od].held) {
+		fast_ods[od].held = 0;
+		user_held = 0;
+		__sync_fetch_and_and(word, ~FAST_LOCK_HOLDER);
+		exit_np();
+		return 0;
+	}
+
+	ret = litmus_syscall(LRT_litmus_unlock, od);
+	if (ret == 0)
+		__sync_fetch_and_sub(word, FAST_LOCK_KERNEL);
+	return ret;
+}
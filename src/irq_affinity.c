@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "litmus.h"
+#include "irq_affinity.h"
+#include "internal.h"
+
+/* upper bound of the size of /proc/interrupts that is parsed */
+#define INTERRUPTS_MAX_SIZE (1 << 20)
+/* upper bound of the number of device interrupts that are steered */
+#define MAX_IRQS 4096
+
+static char proc_root[256] = "/proc";
+
+int irq_set_proc_root(const char *root)
+{
+	if (!root)
+		root = "/proc";
+	if (strlen(root) >= sizeof(proc_root)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(proc_root, root);
+	return 0;
+}
+
+/* Parse /proc/interrupts. The header names the CPU of each column
+ * ("CPU0 CPU1 ..."; offline CPUs are left out); each following line starts
+ * with a label ("0:" for device interrupts, "LOC:" etc. for others),
+ * followed by one count per column and a description. Returns one more than
+ * the highest CPU, or -1. */
+static int parse_interrupts(unsigned long long *device,
+			    unsigned long long *all, int max_cpus,
+			    int *irqs, int max_irqs, int *num_irqs)
+{
+	char fname[sizeof(proc_root) + 16];
+	int cols[IRQ_MAX_CPUS];
+	char *buf, *line, *next, *end;
+	unsigned long long count;
+	int ncols = 0, num_cpus = 0, c, numbered;
+	ssize_t len;
+
+	if (device)
+		memset(device, 0, max_cpus * sizeof(*device));
+	if (all)
+		memset(all, 0, max_cpus * sizeof(*all));
+	if (num_irqs)
+		*num_irqs = 0;
+
+	buf = malloc(INTERRUPTS_MAX_SIZE);
+	if (!buf)
+		return -1;
+	snprintf(fname, sizeof(fname), "%s/interrupts", proc_root);
+	len = read_file(fname, buf, INTERRUPTS_MAX_SIZE - 1);
+	if (len <= 0) {
+		free(buf);
+		return -1;
+	}
+	buf[len] = '\0';
+
+	/* header */
+	line = buf;
+	next = strchr(line, '\n');
+	if (next)
+		*next++ = '\0';
+	while ((line = strstr(line, "CPU")) && ncols < IRQ_MAX_CPUS) {
+		cols[ncols] = strtol(line + 3, &end, 10);
+		if (end == line + 3)
+			break;
+		if (cols[ncols] >= num_cpus)
+			num_cpus = cols[ncols] + 1;
+		ncols++;
+		line = end;
+	}
+	if (!ncols) {
+		free(buf);
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (line = next; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		while (isspace((unsigned char) *line))
+			line++;
+		numbered = isdigit((unsigned char) *line);
+		if (numbered && irqs && *num_irqs < max_irqs)
+			irqs[(*num_irqs)++] = atoi(line);
+		line = strchr(line, ':');
+		if (!line)
+			continue;
+		line++;
+
+		/* lines such as "ERR:" have a single count, not one per CPU */
+		for (c = 0; c < ncols; c++) {
+			count = strtoull(line, &end, 10);
+			if (end == line)
+				break;
+			line = end;
+			if (cols[c] >= max_cpus)
+				continue;
+			if (all)
+				all[cols[c]] += count;
+			if (numbered && device)
+				device[cols[c]] += count;
+		}
+	}
+
+	free(buf);
+	return num_cpus < max_cpus ? num_cpus : max_cpus;
+}
+
+int irq_read_counts(unsigned long long *device, unsigned long long *all,
+		    int max_cpus)
+{
+	return parse_interrupts(device, all, max_cpus, NULL, 0, NULL);
+}
+
+int irq_list(int *irqs, int max_irqs)
+{
+	int num_irqs;
+
+	if (parse_interrupts(NULL, NULL, 0, irqs, max_irqs, &num_irqs) < 0)
+		return -1;
+	return num_irqs;
+}
+
+int irq_get_affinity(int irq, unsigned long long *mask)
+{
+	char fname[sizeof(proc_root) + 32];
+	/* 4096 CPUs: 1024 hex digits and a comma per 8 of them */
+	char buf[1024 + 128 + 1];
+	ssize_t len, i;
+
+	snprintf(fname, sizeof(fname), "%s/irq/%d/smp_affinity",
+		 proc_root, irq);
+	len = read_file(fname, buf, sizeof(buf) - 1);
+	if (len <= 0)
+		return -1;
+
+	/* groups of 32 bits, most significant first, separated by commas */
+	*mask = 0;
+	for (i = 0; i < len && buf[i] != '\n'; i++) {
+		if (buf[i] == ',')
+			continue;
+		if (!isxdigit((unsigned char) buf[i])) {
+			errno = EINVAL;
+			return -1;
+		}
+		*mask = *mask << 4 |
+			(isdigit((unsigned char) buf[i]) ? buf[i] - '0' :
+			 tolower((unsigned char) buf[i]) - 'a' + 10);
+	}
+	return 0;
+}
+
+int irq_set_affinity(int irq, unsigned long long mask)
+{
+	char fname[sizeof(proc_root) + 32];
+	char buf[32];
+	int fd, len, ret;
+
+	if (!mask) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* the kernel parses at most 32 bits per comma-separated group */
+	if (mask >> 32)
+		len = snprintf(buf, sizeof(buf), "%x,%08x\n",
+			       (unsigned int) (mask >> 32), (unsigned int) mask);
+	else
+		len = snprintf(buf, sizeof(buf), "%x\n", (unsigned int) mask);
+
+	snprintf(fname, sizeof(fname), "%s/irq/%d/smp_affinity",
+		 proc_root, irq);
+	fd = open(fname, O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		return -1;
+	ret = write(fd, buf, len) == len ? 0 : -1;
+	close(fd);
+	return ret;
+}
+
+int irq_rt_cpus(unsigned long long *rt, unsigned long long *housekeeping)
+{
+	unsigned long long mask, online;
+	int domain, master, num_cpus = num_online_cpus();
+
+	*rt = 0;
+	for (domain = 0; domain_to_cpus(domain, &mask) == 0; domain++)
+		*rt |= mask;
+	if (!domain)
+		return -1;
+
+	online = num_cpus >= IRQ_MAX_CPUS ? ~0ULL : (1ULL << num_cpus) - 1;
+	master = release_master();
+	if (master >= 0 && master < IRQ_MAX_CPUS) {
+		*rt &= ~(1ULL << master);
+		*housekeeping = 1ULL << master;
+	} else
+		*housekeeping = online & ~*rt;
+	return 0;
+}
+
+int irq_steer_away(unsigned long long rt, unsigned long long housekeeping,
+		   int *moved, int *failed)
+{
+	unsigned long long old, new;
+	int *irqs, num_irqs, i, num_moved = 0, num_failed = 0;
+
+	if (!housekeeping) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	irqs = malloc(MAX_IRQS * sizeof(int));
+	if (!irqs)
+		return -1;
+	num_irqs = irq_list(irqs, MAX_IRQS);
+	if (num_irqs < 0) {
+		free(irqs);
+		return -1;
+	}
+
+	for (i = 0; i < num_irqs; i++) {
+		if (irq_get_affinity(irqs[i], &old) != 0) {
+			num_failed++;
+			continue;
+		}
+		new = old & ~rt;
+		if (!new)
+			new = housekeeping;
+		if (new == old)
+			continue;
+		if (irq_set_affinity(irqs[i], new) == 0)
+			num_moved++;
+		else
+			num_failed++;
+	}
+
+	free(irqs);
+	if (moved)
+		*moved = num_moved;
+	if (failed)
+		*failed = num_failed;
+	return 0;
+}
@@ -0,0 +1,253 @@
+/* Per-job interrupt interference accounting.
+ *
+ * The kernel counts the interrupts that hit a real-time task in its control
+ * page (irq_count). Sampling the counter at the release and at the
+ * completion of each job yields the number of interrupts that the job
+ * suffered; comparing the job's measured execution time with the time it
+ * was expected to take yields the inflation due to them (and any other
+ * interference that the thread's CPU time includes). Only the thread itself
+ * samples its counters, so its state is not protected; it is allocated on
+ * the thread's first job and registered in a process-wide list, from which
+ * exit_litmus() reports and frees the states of all threads.
+ *
+ * Execution times are measured as thread CPU time (CLOCK_THREAD_CPUTIME_ID),
+ * which excludes the time spent preempted by other tasks. Whether it
+ * includes the time spent in interrupt handlers depends on the kernel: with
+ * CONFIG_IRQ_TIME_ACCOUNTING, hard and soft interrupt time is accounted
+ * separately and not charged to the interrupted thread, so the inflation
+ * covers only the indirect cost of interrupts (e.g., evicted cache lines);
+ * without it, the handlers' execution time is included as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+
+#include "litmus.h"
+#include "internal.h"
+
+/* whether the statistics are dumped by exit_litmus() */
+static int dump_at_exit;
+
+struct job_irq_state {
+	struct thread_record record;  /* must be first */
+	struct litmus_irq_stats stats;
+	uint64_t irq_count;
+	lt_t exec_start;
+	int in_job;
+	int cpu;  /* of the last job */
+};
+
+/* the states of all threads */
+static struct thread_record *all_states;
+
+static __thread struct job_irq_state *job_state;
+
+static struct job_irq_state *get_job_state(void)
+{
+	if (unlikely(!job_state)) {
+		job_state = calloc(1, sizeof(struct job_irq_state));
+		if (job_state)
+			thread_record_add(&all_states, &job_state->record);
+	}
+	return job_state;
+}
+
+void irq_stats_init(void)
+{
+	const char *env = getenv("LITMUS_IRQ_STATS");
+
+	dump_at_exit = env && *env && strcmp(env, "0") != 0;
+}
+
+void irq_stats_exit(void)
+{
+	struct thread_record *r, *next;
+	struct job_irq_state *state;
+	char label[64];
+
+	/* called once for the entire program (see lock_stats_exit()) */
+	for (r = thread_record_take(&all_states); r; r = next) {
+		next = r->next;
+		state = (struct job_irq_state *) r;
+		if (dump_at_exit && state->stats.jobs) {
+			snprintf(label, sizeof(label),
+				 "irq-stats tid=%d cpu=%d", r->tid, state->cpu);
+			litmus_irq_stats_print(stderr, label, &state->stats);
+		}
+		free(r);
+	}
+	job_state = NULL;
+}
+
+static lt_t thread_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return s2ns(ts.tv_sec) + ts.tv_nsec;
+}
+
+int litmus_irq_job_begin(void)
+{
+	struct control_page *cp = get_ctrl_page();
+	struct job_irq_state *state;
+
+	if (!cp) {
+		errno = ENODEV;
+		return -1;
+	}
+	state = get_job_state();
+	if (!state)
+		return -1;
+
+	state->irq_count = cp->irq_count;
+	state->exec_start = thread_time();
+	state->in_job = 1;
+	return 0;
+}
+
+int litmus_irq_job_end(lt_t expected_exec)
+{
+	struct control_page *cp = get_ctrl_page();
+	struct litmus_irq_stats *s;
+	uint64_t irqs;
+	lt_t exec, inflation;
+
+	if (!cp || !job_state || !job_state->in_job) {
+		errno = cp ? EINVAL : ENODEV;
+		return -1;
+	}
+
+	exec = thread_time() - job_state->exec_start;
+	irqs = cp->irq_count - job_state->irq_count;
+	job_state->in_job = 0;
+	job_state->cpu = sched_getcpu();
+	s = &job_state->stats;
+
+	s->jobs++;
+	s->irqs += irqs;
+	if (irqs)
+		s->jobs_with_irqs++;
+	if (irqs > s->max_irqs)
+		s->max_irqs = irqs;
+	s->irq_hist[irqs < LITMUS_IRQ_STATS_BUCKETS ?
+		    irqs : LITMUS_IRQ_STATS_BUCKETS - 1]++;
+	s->exec_total += exec;
+
+	if (!expected_exec)
+		return 0;
+
+	/* jobs that take less than expected were not inflated */
+	inflation = exec > expected_exec ? exec - expected_exec : 0;
+	s->timed_jobs++;
+	s->timed_irqs += irqs;
+	s->inflation_total += inflation;
+	if (inflation > s->inflation_max)
+		s->inflation_max = inflation;
+	s->sum_irqs_sq += (double) irqs * irqs;
+	s->sum_irqs_inflation += (double) irqs * inflation;
+	s->sum_inflation_sq += (double) inflation * inflation;
+	if (irqs)
+		s->inflation_hist[log2_bucket(inflation / irqs,
+					      LITMUS_IRQ_STATS_BUCKETS)]++;
+	return 0;
+}
+
+void litmus_irq_stats_get(struct litmus_irq_stats *stats)
+{
+	if (job_state)
+		*stats = job_state->stats;
+	else
+		memset(stats, 0, sizeof(*stats));
+}
+
+void litmus_irq_stats_reset(void)
+{
+	if (job_state)
+		memset(&job_state->stats, 0, sizeof(job_state->stats));
+}
+
+void litmus_irq_stats_merge(struct litmus_irq_stats *into,
+			    const struct litmus_irq_stats *from)
+{
+	int i;
+
+	into->jobs += from->jobs;
+	into->jobs_with_irqs += from->jobs_with_irqs;
+	into->irqs += from->irqs;
+	if (from->max_irqs > into->max_irqs)
+		into->max_irqs = from->max_irqs;
+	into->exec_total += from->exec_total;
+	into->timed_jobs += from->timed_jobs;
+	into->timed_irqs += from->timed_irqs;
+	into->inflation_total += from->inflation_total;
+	if (from->inflation_max > into->inflation_max)
+		into->inflation_max = from->inflation_max;
+	into->sum_irqs_sq += from->sum_irqs_sq;
+	into->sum_irqs_inflation += from->sum_irqs_inflation;
+	into->sum_inflation_sq += from->sum_inflation_sq;
+	for (i = 0; i < LITMUS_IRQ_STATS_BUCKETS; i++) {
+		into->irq_hist[i] += from->irq_hist[i];
+		into->inflation_hist[i] += from->inflation_hist[i];
+	}
+}
+
+int litmus_irq_stats_fit(const struct litmus_irq_stats *s,
+			 double *per_irq, double *r2)
+{
+	double n = s->timed_jobs, x = s->timed_irqs, y = s->inflation_total;
+	double sxx = n * s->sum_irqs_sq - x * x;
+	double syy = n * s->sum_inflation_sq - y * y;
+	double sxy = n * s->sum_irqs_inflation - x * y;
+
+	/* without variation in the interrupt counts, there is nothing to fit */
+	if (s->timed_jobs < 2 || sxx <= 0)
+		return -1;
+
+	*per_irq = sxy / sxx;
+	*r2 = syy > 0 ? sxy * sxy / (sxx * syy) : 0;
+	return 0;
+}
+
+void litmus_irq_stats_print(FILE *out, const char *label,
+			    const struct litmus_irq_stats *s)
+{
+	unsigned long long n = s->jobs, t = s->timed_jobs;
+	double per_irq, r2;
+	int i;
+
+	fprintf(out, "%s: jobs=%llu irqs=%llu jobs-with-irqs=%llu "
+		"irqs-per-job(mean=%.2f max=%llu) exec(mean=%llu)\n",
+		label, n, (unsigned long long) s->irqs,
+		(unsigned long long) s->jobs_with_irqs,
+		n ? (double) s->irqs / n : 0.0,
+		(unsigned long long) s->max_irqs,
+		n ? (unsigned long long) s->exec_total / n : 0);
+	if (t) {
+		fprintf(out, "  inflation: mean=%llu max=%llu",
+			(unsigned long long) s->inflation_total / t,
+			(unsigned long long) s->inflation_max);
+		if (litmus_irq_stats_fit(s, &per_irq, &r2) == 0)
+			fprintf(out, " per-irq=%.0f r2=%.2f", per_irq, r2);
+		fprintf(out, "\n");
+	}
+
+	fprintf(out, "  irqs-per-job:");
+	for (i = 0; i < LITMUS_IRQ_STATS_BUCKETS; i++)
+		if (s->irq_hist[i])
+			fprintf(out, " %d%s:%llu", i,
+				i == LITMUS_IRQ_STATS_BUCKETS - 1 ? "+" : "",
+				(unsigned long long) s->irq_hist[i]);
+	fprintf(out, "\n");
+
+	fprintf(out, "  inflation-per-irq:");
+	for (i = 0; i < LITMUS_IRQ_STATS_BUCKETS; i++)
+		if (s->inflation_hist[i])
+			fprintf(out, " 2^%d:%llu", i,
+				(unsigned long long) s->inflation_hist[i]);
+	fprintf(out, "\n");
+}
@@ -7,6 +7,7 @@
 
 
 #include <stdio.h>
+#include <string.h>
 
 #include "litmus.h"
 #include "internal.h"
@@ -57,18 +58,81 @@ ssize_t read_file(const char* fname, void* buf, size_t maxlen)
 		return got;
 }
 
+int open_file_handle(const char* fname)
+{
+	return open(fname, O_RDONLY | O_CLOEXEC);
+}
+
+ssize_t read_file_handle(int handle, void* buf, size_t maxlen)
+{
+	ssize_t n = 0;
+	size_t got = 0;
+
+	/* procfs regenerates the contents when read from offset 0 */
+	while (got < maxlen &&
+	       (n = pread(handle, buf + got, maxlen - got, got)) > 0)
+		got += n;
+	if (n < 0)
+		return -1;
+	else
+		return got;
+}
+
+void close_file_handle(int handle)
+{
+	close(handle);
+}
+
+int cached_file_handle(int *handle, const char* fname)
+{
+	int fd = *handle;
+
+	if (fd < 0) {
+		fd = open_file_handle(fname);
+		/* another thread may have been faster */
+		if (fd >= 0 && !__sync_bool_compare_and_swap(handle, -1, fd)) {
+			close(fd);
+			fd = *handle;
+		}
+	}
+	return fd;
+}
+
+/* Parse the number after the next '=' in buf; returns the position after
+ * the number, or NULL if there is none. */
+static const char *parse_field(const char *buf, int *val)
+{
+	buf = strchr(buf, '=');
+	if (!buf)
+		return NULL;
+	for (buf++; *buf == ' '; buf++)
+		;
+	if (*buf < '0' || *buf > '9')
+		return NULL;
+	for (*val = 0; *buf >= '0' && *buf <= '9'; buf++)
+		*val = *val * 10 + (*buf - '0');
+	return buf;
+}
+
 int read_litmus_stats(int *ready, int *all)
 {
+	static int handle = -1;
 	char buf[100];
+	const char *pos;
 	ssize_t len;
+	int fd;
 
-	len = read_file(LITMUS_STATS_FILE, buf, sizeof(buf) - 1);
-	if (len >= 0)
-		len = sscanf(buf,
-			     "real-time tasks   = %d\n"
-			     "ready for release = %d\n",
-			     all, ready);
-	return len == 2;
+	fd = cached_file_handle(&handle, LITMUS_STATS_FILE);
+	if (fd < 0)
+		return 0;
+	len = read_file_handle(fd, buf, sizeof(buf) - 1);
+	if (len < 0)
+		return 0;
+	buf[len] = '\0';
+
+	/* "real-time tasks   = <all>\nready for release = <ready>\n" */
+	pos = parse_field(buf, all);
+	return pos && parse_field(pos, ready) != NULL;
 }
 
 int get_nr_ts_release_waiters(void)
@@ -6,6 +6,7 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 
 
 #include <sched.h> /* for cpu sets */
@@ -53,22 +54,158 @@ const char* name_for_lock_protocol(int id)
 	return "<UNKNOWN>";
 }
 
+/* Namespace files stay open after the first lock in them has been opened,
+ * so that tasks with many resources do not open the same file again and
+ * again. */
+#define MAX_CACHED_NAMESPACES 16
+
+static struct {
+	char *path;
+	int fd;
+	dev_t dev;
+	ino_t ino;
+} ns_cache[MAX_CACHED_NAMESPACES];
+
+static int ns_cache_lock;
+
+static void lock_ns_cache(void)
+{
+	while (__sync_lock_test_and_set(&ns_cache_lock, 1))
+		sched_yield();
+}
+
+static void unlock_ns_cache(void)
+{
+	__sync_lock_release(&ns_cache_lock);
+}
+
+static void drop_namespace(int i)
+{
+	close(ns_cache[i].fd);
+	free(ns_cache[i].path);
+	ns_cache[i].path = NULL;
+}
+
+int get_namespace_fd(const char *namespace, int *cached,
+		     dev_t *dev, ino_t *ino)
+{
+	struct stat st;
+	int i, fd, slot = -1;
+
+	lock_ns_cache();
+	for (i = 0; i < MAX_CACHED_NAMESPACES; i++) {
+		if (!ns_cache[i].path) {
+			if (slot < 0)
+				slot = i;
+			continue;
+		}
+		if (strcmp(ns_cache[i].path, namespace) != 0)
+			continue;
+
+		/* the file may have been removed and re-created since */
+		if (stat(namespace, &st) == 0 &&
+		    st.st_dev == ns_cache[i].dev &&
+		    st.st_ino == ns_cache[i].ino) {
+			fd = ns_cache[i].fd;
+			unlock_ns_cache();
+			*cached = 1;
+			*dev = st.st_dev;
+			*ino = st.st_ino;
+			return fd;
+		}
+		drop_namespace(i);
+		slot = i;
+		break;
+	}
+
+	*cached = 0;
+	fd = open(namespace, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (fd >= 0 && fstat(fd, &st) != 0) {
+		close(fd);
+		fd = -1;
+	}
+	if (fd >= 0) {
+		*dev = st.st_dev;
+		*ino = st.st_ino;
+		if (slot >= 0 && (ns_cache[slot].path = strdup(namespace))) {
+			ns_cache[slot].fd = fd;
+			ns_cache[slot].dev = st.st_dev;
+			ns_cache[slot].ino = st.st_ino;
+			*cached = 1;
+		}
+	}
+	unlock_ns_cache();
+	return fd;
+}
+
+void put_namespace_fd(int fd, int cached)
+{
+	if (!cached)
+		close(fd);
+}
+
+void close_namespaces(void)
+{
+	int i;
+
+	lock_ns_cache();
+	for (i = 0; i < MAX_CACHED_NAMESPACES; i++)
+		if (ns_cache[i].path)
+			drop_namespace(i);
+	unlock_ns_cache();
+}
+
 int litmus_open_lock(
 	obj_type_t protocol,
 	int lock_id,
 	const char* namespace,
 	void *config_param)
 {
-	int fd, od;
+	int od;
 
-	fd = open(namespace, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-	if (fd < 0)
+	if (litmus_open_locks(protocol, &lock_id, 1, namespace,
+			      config_param, &od) != 0)
 		return -1;
-	od = od_openx(fd, protocol, lock_id, config_param);
-	close(fd);
 	return od;
 }
 
+int litmus_open_locks(
+	obj_type_t protocol,
+	const int *lock_ids,
+	int num_locks,
+	const char* namespace,
+	void *config_param,
+	int *ods)
+{
+	int fd, i, cached;
+	dev_t dev;
+	ino_t ino;
+
+	/* the namespace is looked up (and checked for being current) once
+	 * per batch, and its identity is passed on, so that the individual
+	 * opens do not need to stat it again */
+	fd = get_namespace_fd(namespace, &cached, &dev, &ino);
+	if (fd < 0)
+		return -1;
+
+	for (i = 0; i < num_locks; i++) {
+		ods[i] = od_open_keyed(fd, protocol, lock_ids[i],
+				       config_param, dev, ino);
+		if (ods[i] < 0)
+			break;
+	}
+
+	put_namespace_fd(fd, cached);
+
+	if (i < num_locks) {
+		/* undo the partial batch */
+		while (i > 0)
+			od_close(ods[--i]);
+		return -1;
+	}
+	return 0;
+}
+
 
 
 void show_rt_param(struct rt_task* tp)
@@ -183,6 +320,8 @@ int init_rt_thread(void)
 {
 	int ret;
 
+	lock_stats_init();
+	irq_stats_init();
         ret = init_kernel_iface();
 	check("kernel <-> user space interface initialization");
 	return ret;
@@ -190,5 +329,7 @@ int init_rt_thread(void)
 
 void exit_litmus(void)
 {
-	/* nothing to do in current version */
+	lock_stats_exit();
+	irq_stats_exit();
+	close_namespaces();
 }
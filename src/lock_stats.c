@@ -0,0 +1,221 @@
+/* Per-lock blocking and hold-time accounting.
+ *
+ * When enabled, litmus_lock() and litmus_unlock() record, for each object
+ * descriptor, how long acquisitions took (including any blocking) and how
+ * long the lock was held. Since object descriptors are per-task (i.e.,
+ * per-thread) indices, the statistics live in a per-thread table and are
+ * updated without any synchronization; threads that want a process-wide
+ * view combine their tables with litmus_lock_stats_merge(). Each table is
+ * also registered in a process-wide list, so that exit_litmus() can report
+ * and free the tables of all threads, including those that have exited.
+ *
+ * Times are in cycles (get_cycles()), as reading the cycle counter is cheap
+ * enough to not distort the critical sections being measured.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "litmus.h"
+#include "internal.h"
+
+/* Set once (before the threads of interest lock anything) and only read
+ * afterwards, hence no need for atomic accesses. */
+int lock_stats_enabled;
+
+/* whether the statistics are dumped by exit_litmus() */
+static int dump_at_exit;
+
+struct od_lock_stats {
+	struct litmus_lock_stats stats;
+	cycles_t acquired_at;
+	int held;
+};
+
+struct thread_lock_stats {
+	struct thread_record record;  /* must be first */
+	struct od_lock_stats od[LITMUS_LOCK_STATS_MAX_OD];
+};
+
+/* the tables of all threads */
+static struct thread_record *all_stats;
+
+static __thread struct thread_lock_stats *thread_stats;
+
+static struct thread_lock_stats *get_thread_stats(void)
+{
+	if (unlikely(!thread_stats)) {
+		thread_stats = calloc(1, sizeof(struct thread_lock_stats));
+		if (thread_stats)
+			thread_record_add(&all_stats, &thread_stats->record);
+	}
+	return thread_stats;
+}
+
+void litmus_lock_stats_enable(int enable)
+{
+	lock_stats_enabled = enable;
+	/* avoid allocating the calling thread's table in its first lock */
+	if (enable)
+		get_thread_stats();
+}
+
+void lock_stats_init(void)
+{
+	const char *env = getenv("LITMUS_LOCK_STATS");
+
+	if (env && *env && strcmp(env, "0") != 0) {
+		dump_at_exit = 1;
+		litmus_lock_stats_enable(1);
+	} else if (lock_stats_enabled) {
+		get_thread_stats();
+	}
+}
+
+static void dump_table(FILE *out, const struct thread_lock_stats *t)
+{
+	char label[64];
+	int od;
+
+	for (od = 0; od < LITMUS_LOCK_STATS_MAX_OD; od++) {
+		if (!t->od[od].stats.acquisitions && !t->od[od].stats.failures)
+			continue;
+		snprintf(label, sizeof(label), "lock-stats tid=%d od=%d",
+			 t->record.tid, od);
+		litmus_lock_stats_print(out, label, &t->od[od].stats);
+	}
+}
+
+void lock_stats_exit(void)
+{
+	struct thread_record *r, *next;
+
+	/* called once for the entire program, when the other threads no
+	 * longer lock anything */
+	for (r = thread_record_take(&all_stats); r; r = next) {
+		next = r->next;
+		if (dump_at_exit)
+			dump_table(stderr, (struct thread_lock_stats *) r);
+		free(r);
+	}
+	thread_stats = NULL;
+}
+
+void lock_stats_locked(int od, int ret, cycles_t start, cycles_t end)
+{
+	struct thread_lock_stats *t;
+	struct od_lock_stats *s;
+	cycles_t wait = end - start;
+
+	if (od < 0 || od >= LITMUS_LOCK_STATS_MAX_OD)
+		return;
+	t = get_thread_stats();
+	if (!t)
+		return;
+	s = t->od + od;
+
+	if (ret != 0) {
+		s->stats.failures++;
+		return;
+	}
+
+	s->stats.acquisitions++;
+	s->stats.wait_total += wait;
+	if (wait > s->stats.wait_max)
+		s->stats.wait_max = wait;
+	s->stats.wait_hist[log2_bucket(wait, LITMUS_LOCK_STATS_BUCKETS)]++;
+
+	s->acquired_at = end;
+	s->held = 1;
+}
+
+void lock_stats_unlocked(int od, int ret, cycles_t end)
+{
+	struct od_lock_stats *s;
+	cycles_t hold;
+
+	if (ret != 0 || od < 0 || od >= LITMUS_LOCK_STATS_MAX_OD ||
+	    !thread_stats || !thread_stats->od[od].held)
+		return;
+	s = thread_stats->od + od;
+
+	hold = end - s->acquired_at;
+	s->held = 0;
+	s->stats.hold_total += hold;
+	if (hold > s->stats.hold_max)
+		s->stats.hold_max = hold;
+	s->stats.hold_hist[log2_bucket(hold, LITMUS_LOCK_STATS_BUCKETS)]++;
+}
+
+int litmus_lock_stats_get(int od, struct litmus_lock_stats *stats)
+{
+	if (od < 0 || od >= LITMUS_LOCK_STATS_MAX_OD) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (thread_stats)
+		*stats = thread_stats->od[od].stats;
+	else
+		memset(stats, 0, sizeof(*stats));
+	return 0;
+}
+
+void litmus_lock_stats_reset(void)
+{
+	if (thread_stats)
+		memset(thread_stats->od, 0, sizeof(thread_stats->od));
+}
+
+void litmus_lock_stats_merge(struct litmus_lock_stats *into,
+			     const struct litmus_lock_stats *from)
+{
+	int i;
+
+	into->acquisitions += from->acquisitions;
+	into->failures += from->failures;
+	into->wait_total += from->wait_total;
+	into->hold_total += from->hold_total;
+	if (from->wait_max > into->wait_max)
+		into->wait_max = from->wait_max;
+	if (from->hold_max > into->hold_max)
+		into->hold_max = from->hold_max;
+	for (i = 0; i < LITMUS_LOCK_STATS_BUCKETS; i++) {
+		into->wait_hist[i] += from->wait_hist[i];
+		into->hold_hist[i] += from->hold_hist[i];
+	}
+}
+
+static void dump_hist(FILE *out, const char *name, const uint64_t *hist)
+{
+	int i;
+
+	fprintf(out, "  %s:", name);
+	for (i = 0; i < LITMUS_LOCK_STATS_BUCKETS; i++)
+		if (hist[i])
+			fprintf(out, " 2^%d:%llu", i, (unsigned long long) hist[i]);
+	fprintf(out, "\n");
+}
+
+void litmus_lock_stats_print(FILE *out, const char *label,
+			     const struct litmus_lock_stats *s)
+{
+	unsigned long long n = s->acquisitions;
+
+	fprintf(out, "%s: acquisitions=%llu failures=%llu "
+		"wait(mean=%llu max=%" CYCLES_FMT ") "
+		"hold(mean=%llu max=%" CYCLES_FMT ")\n",
+		label, n, (unsigned long long) s->failures,
+		n ? (unsigned long long) s->wait_total / n : 0, s->wait_max,
+		n ? (unsigned long long) s->hold_total / n : 0, s->hold_max);
+	dump_hist(out, "wait", s->wait_hist);
+	dump_hist(out, "hold", s->hold_hist);
+}
+
+void litmus_lock_stats_dump(FILE *out)
+{
+	if (thread_stats)
+		dump_table(out, thread_stats);
+}
@@ -0,0 +1,159 @@
+/* Acquisition of several locks as a group.
+ *
+ * LITMUS^RT has no system call that acquires a set of resources at once, so
+ * a group is acquired one lock at a time, in a global order: by the
+ * namespace file (device and inode) and then by lock id. Since every task
+ * that uses litmus_lock_group() acquires shared locks in the same order,
+ * groups cannot deadlock with each other. The order key of each object
+ * descriptor is recorded when the lock is opened; descriptors without a key
+ * cannot be part of a group.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include "litmus.h"
+#include "internal.h"
+
+struct lock_key {
+	dev_t dev;
+	ino_t ino;
+	int id;
+	int valid;
+};
+
+/* like object descriptors, per task; grows with the highest descriptor */
+static __thread struct lock_key *lock_keys;
+static __thread int num_lock_keys;
+
+static struct lock_key *get_lock_key(int od)
+{
+	struct lock_key *table;
+	int n;
+
+	if (od < num_lock_keys)
+		return lock_keys + od;
+
+	for (n = num_lock_keys ? num_lock_keys : 16; n <= od; n *= 2)
+		;
+	table = realloc(lock_keys, n * sizeof(*table));
+	if (!table)
+		return NULL;
+	memset(table + num_lock_keys, 0,
+	       (n - num_lock_keys) * sizeof(*table));
+	lock_keys = table;
+	num_lock_keys = n;
+	return lock_keys + od;
+}
+
+void lock_group_remember(int od, dev_t dev, ino_t ino, int obj_id)
+{
+	struct lock_key *key;
+
+	if (od < 0 || !(key = get_lock_key(od)))
+		return;
+	key->dev = dev;
+	key->ino = ino;
+	key->id = obj_id;
+	key->valid = 1;
+}
+
+void lock_group_forget(int od)
+{
+	if (od >= 0 && od < num_lock_keys)
+		lock_keys[od].valid = 0;
+}
+
+static int has_key(int od)
+{
+	return od >= 0 && od < num_lock_keys && lock_keys[od].valid;
+}
+
+static int cmp_locks(int a, int b)
+{
+	const struct lock_key *x, *y;
+
+	x = lock_keys + a;
+	y = lock_keys + b;
+	if (x->dev != y->dev)
+		return x->dev < y->dev ? -1 : 1;
+	if (x->ino != y->ino)
+		return x->ino < y->ino ? -1 : 1;
+	return (x->id > y->id) - (x->id < y->id);
+}
+
+/* Sort a copy of the group into acquisition order; fails for empty,
+ * oversized, or duplicate groups, and for descriptors without a key. */
+static int order_group(const int *ods, int num_ods, int *ordered)
+{
+	int i, j, od;
+
+	if (num_ods <= 0 || num_ods > LITMUS_MAX_LOCK_GROUP) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* groups are small, insertion sort will do */
+	for (i = 0; i < num_ods; i++) {
+		od = ods[i];
+		if (!has_key(od)) {
+			errno = EINVAL;
+			return -1;
+		}
+		for (j = i; j > 0 && cmp_locks(od, ordered[j - 1]) < 0; j--)
+			ordered[j] = ordered[j - 1];
+		ordered[j] = od;
+	}
+
+	for (i = 1; i < num_ods; i++)
+		if (ordered[i] == ordered[i - 1]) {
+			errno = EINVAL;
+			return -1;
+		}
+	return 0;
+}
+
+int litmus_lock_group(const int *ods, int num_ods)
+{
+	int ordered[LITMUS_MAX_LOCK_GROUP];
+	int i, err;
+
+	if (order_group(ods, num_ods, ordered) != 0)
+		return -1;
+
+	for (i = 0; i < num_ods; i++)
+		if (litmus_lock(ordered[i]) != 0)
+			break;
+
+	if (i < num_ods) {
+		/* release what we got, but report the original error */
+		err = errno;
+		while (i > 0)
+			litmus_unlock(ordered[--i]);
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+int litmus_unlock_group(const int *ods, int num_ods)
+{
+	int ordered[LITMUS_MAX_LOCK_GROUP];
+	int i, ret = 0, err = 0;
+
+	if (order_group(ods, num_ods, ordered) != 0)
+		return -1;
+
+	/* release in reverse acquisition order, as nested locks must be */
+	for (i = num_ods - 1; i >= 0; i--)
+		if (litmus_unlock(ordered[i]) != 0 && !ret) {
+			ret = -1;
+			err = errno;
+		}
+
+	if (ret)
+		errno = err;
+	return ret;
+}
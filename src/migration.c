@@ -7,14 +7,20 @@
 #include "migration.h"
 
 extern ssize_t read_file(const char* fname, void* buf, size_t maxlen);
+extern ssize_t read_file_handle(int handle, void* buf, size_t maxlen);
+extern int cached_file_handle(int *handle, const char* fname);
 
 int release_master()
 {
 	static const char NO_CPU[] = "NO_CPU";
+	static int handle = -1;
 	char buf[7] = {0}; /* up to 999999 CPUs */
 	int master = -1;
+	int ret = -1, fd;
 
-	int ret = read_file("/proc/litmus/release_master", &buf, sizeof(buf)-1);
+	fd = cached_file_handle(&handle, "/proc/litmus/release_master");
+	if (fd >= 0)
+		ret = read_file_handle(fd, &buf, sizeof(buf)-1);
 
 	if ((ret > 0) && (strncmp(buf, NO_CPU, sizeof(NO_CPU)-1) != 0))
 		master = atoi(buf);
@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "litmus.h"
+#include "spinlock.h"
+
+static inline void cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("pause" : : : "memory");
+#else
+	__sync_synchronize();
+#endif
+}
+
+void litmus_ticket_init(struct litmus_ticket_lock *lock)
+{
+	lock->next = 0;
+	lock->owner = 0;
+	__sync_synchronize();
+}
+
+void litmus_ticket_lock(struct litmus_ticket_lock *lock)
+{
+	uint32_t ticket;
+
+	enter_np();
+	ticket = __sync_fetch_and_add(&lock->next, 1);
+	while (lock->owner != ticket)
+		cpu_relax();
+	/* keep the critical section after the acquisition */
+	__sync_synchronize();
+}
+
+void litmus_ticket_unlock(struct litmus_ticket_lock *lock)
+{
+	/* only the owner writes owner, no atomic increment needed */
+	__sync_synchronize();
+	lock->owner = lock->owner + 1;
+	exit_np();
+}
+
+size_t litmus_mcs_size(int num_slots)
+{
+	return sizeof(struct litmus_mcs_lock) +
+		num_slots * sizeof(struct litmus_mcs_node);
+}
+
+void litmus_mcs_init(struct litmus_mcs_lock *lock, int num_slots)
+{
+	memset(lock, 0, litmus_mcs_size(num_slots));
+	lock->num_slots = num_slots;
+	__sync_synchronize();
+}
+
+void litmus_mcs_lock(struct litmus_mcs_lock *lock, int slot)
+{
+	struct litmus_mcs_node *me = lock->node + slot;
+	uint32_t pred;
+
+	enter_np();
+	me->next = 0;
+	me->locked = 1;
+	__sync_synchronize();
+
+	/* slots are stored + 1, so that 0 means "none" */
+	do {
+		pred = lock->tail;
+	} while (!__sync_bool_compare_and_swap(&lock->tail, pred, slot + 1));
+
+	if (pred) {
+		lock->node[pred - 1].next = slot + 1;
+		while (me->locked)
+			cpu_relax();
+	}
+	__sync_synchronize();
+}
+
+void litmus_mcs_unlock(struct litmus_mcs_lock *lock, int slot)
+{
+	struct litmus_mcs_node *me = lock->node + slot;
+
+	__sync_synchronize();
+	if (!me->next) {
+		/* no known successor: try to mark the lock free */
+		if (__sync_bool_compare_and_swap(&lock->tail, slot + 1, 0)) {
+			exit_np();
+			return;
+		}
+		/* a successor is enqueueing, wait until it links itself */
+		while (!me->next)
+			cpu_relax();
+	}
+	lock->node[me->next - 1].locked = 0;
+	exit_np();
+}
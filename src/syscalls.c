@@ -7,6 +7,8 @@
 
 /* for syscall() */
 #include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 #include "litmus.h"
 #include "internal.h"
@@ -47,9 +49,10 @@ int sleep_next_period(void)
 	return litmus_syscall(LRT_complete_job, 0);
 }
 
-int od_openx(int fd, obj_type_t type, int obj_id, void *config)
+static int do_od_open(int fd, obj_type_t type, int obj_id, void *config)
 {
 	union litmus_syscall_args args;
+
 	args.od_open.fd = fd;
 	args.od_open.obj_type = type;
 	args.od_open.obj_id = obj_id;
@@ -57,21 +60,118 @@ int od_openx(int fd, obj_type_t type, int obj_id, void *config)
 	return litmus_syscall(LRT_od_open, (unsigned long) &args);
 }
 
+int od_openx(int fd, obj_type_t type, int obj_id, void *config)
+{
+	struct stat st;
+	int od;
+
+	od = do_od_open(fd, type, obj_id, config);
+	if (od >= 0 && fstat(fd, &st) == 0)
+		lock_group_remember(od, st.st_dev, st.st_ino, obj_id);
+	return od;
+}
+
+int od_open_keyed(int fd, obj_type_t type, int obj_id, void *config,
+		  dev_t dev, ino_t ino)
+{
+	int od;
+
+	od = do_od_open(fd, type, obj_id, config);
+	if (od >= 0)
+		lock_group_remember(od, dev, ino, obj_id);
+	return od;
+}
+
 int od_close(int od)
 {
+	fast_lock_forget(od);
+	lock_group_forget(od);
 	return litmus_syscall(LRT_od_close, od);
 }
 
+/* locks held by this thread; the kernel does not know about locks held
+ * through the fast path, so their nesting is checked here */
+static __thread int locks_held;
+
+static int do_lock(int od)
+{
+	volatile uint32_t *word = fast_lock_word(od);
+	int ret;
+
+	/* FMLP semaphores cannot be nested with any other lock */
+	if (fast_lock_user_held() || (word && locks_held)) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	if (word)
+		ret = fast_lock(od, word);
+	else
+		ret = litmus_syscall(LRT_litmus_lock, od);
+	if (ret == 0)
+		locks_held++;
+	return ret;
+}
+
+static int do_unlock(int od)
+{
+	volatile uint32_t *word = fast_lock_word(od);
+	int ret;
+
+	if (word)
+		ret = fast_unlock(od, word);
+	else
+		ret = litmus_syscall(LRT_litmus_unlock, od);
+	if (ret == 0 && locks_held)
+		locks_held--;
+	return ret;
+}
+
+#ifdef LITMUS_NO_LOCK_STATS
+
+int litmus_lock(int od)
+{
+	return do_lock(od);
+}
+
+int litmus_unlock(int od)
+{
+	return do_unlock(od);
+}
+
+#else
+
 int litmus_lock(int od)
 {
-	return litmus_syscall(LRT_litmus_lock, od);
+	cycles_t start;
+	int ret;
+
+	if (likely(!lock_stats_enabled))
+		return do_lock(od);
+
+	start = get_cycles();
+	ret = do_lock(od);
+	lock_stats_locked(od, ret, start, get_cycles());
+	return ret;
 }
 
 int litmus_unlock(int od)
 {
-	return litmus_syscall(LRT_litmus_unlock, od);
+	cycles_t end;
+	int ret;
+
+	if (likely(!lock_stats_enabled))
+		return do_unlock(od);
+
+	/* the critical section ends when the release begins */
+	end = get_cycles();
+	ret = do_unlock(od);
+	lock_stats_unlocked(od, ret, end);
+	return ret;
 }
 
+#endif
+
 int get_job_no(unsigned int *job_no)
 {
 	struct control_page* cp = get_ctrl_page();
@@ -8,6 +8,7 @@
 #include "tests.h"
 #include "litmus.h"
 #include "migration.h"
+#include "internal.h"
 
 
 TESTCASE(set_rt_task_param_invalid_pointer, ALL,
@@ -348,3 +349,101 @@ TESTCASE(running_admission, LITMUS,
 	SYSCALL( waitpid(child_rt, &status, 0) );
 	ASSERT( status == 0 );
 }
+
+TESTCASE(file_handle_rereads, ALL,
+	 "kept-open file handles return the current contents")
+{
+	char buf[16];
+	FILE *f;
+	int handle;
+
+	SYSCALL( (f = fopen(".handle_test", "w")) ? 0 : -1 );
+	fputs("a = 1\n", f);
+	fflush(f);
+
+	SYSCALL( handle = open_file_handle(".handle_test") );
+	memset(buf, 0, sizeof(buf));
+	ASSERT( read_file_handle(handle, buf, sizeof(buf) - 1) == 6 );
+	ASSERT( strcmp(buf, "a = 1\n") == 0 );
+
+	rewind(f);
+	fputs("a = 22\n", f);
+	fflush(f);
+
+	memset(buf, 0, sizeof(buf));
+	ASSERT( read_file_handle(handle, buf, sizeof(buf) - 1) == 7 );
+	ASSERT( strcmp(buf, "a = 22\n") == 0 );
+
+	close_file_handle(handle);
+	fclose(f);
+	SYSCALL( remove(".handle_test") );
+}
+
+TESTCASE(read_litmus_stats_repeatedly, LITMUS,
+	 "read /proc/litmus/stats repeatedly")
+{
+	int ready, all, i;
+
+	for (i = 0; i < 3; i++) {
+		ASSERT( read_litmus_stats(&ready, &all) );
+		ASSERT( ready >= 0 && all >= ready );
+	}
+	ASSERT( get_nr_ts_release_waiters() >= 0 );
+}
+
+TESTCASE(irq_stats_per_job, LITMUS,
+	 "account the interrupts of jobs")
+{
+	struct litmus_irq_stats stats;
+
+	SYSCALL( init_rt_thread() );
+	litmus_irq_stats_reset();
+
+	/* no job started */
+	SYSCALL_FAILS( EINVAL, litmus_irq_job_end(0) );
+
+	SYSCALL( litmus_irq_job_begin() );
+	SYSCALL( litmus_irq_job_end(0) );
+	SYSCALL( litmus_irq_job_begin() );
+	SYSCALL( litmus_irq_job_end(1) );
+
+	litmus_irq_stats_get(&stats);
+	ASSERT( stats.jobs == 2 );
+	ASSERT( stats.timed_jobs == 1 );
+	ASSERT( stats.jobs_with_irqs <= 2 );
+	ASSERT( stats.irq_hist[0] + stats.jobs_with_irqs == 2 );
+
+	litmus_irq_stats_reset();
+	litmus_irq_stats_get(&stats);
+	ASSERT( stats.jobs == 0 );
+}
+
+TESTCASE(irq_stats_fit, ALL,
+	 "fit the inflation of jobs to their interrupt counts")
+{
+	struct litmus_irq_stats a, b;
+	double per_irq, r2;
+
+	/* jobs with 0 and 2 interrupts, inflated by 100ns and 2100ns */
+	memset(&a, 0, sizeof(a));
+	a.jobs = a.timed_jobs = 1;
+	a.inflation_total = 100;
+	a.sum_inflation_sq = 100.0 * 100;
+
+	memset(&b, 0, sizeof(b));
+	b.jobs = b.timed_jobs = b.jobs_with_irqs = 1;
+	b.irqs = b.timed_irqs = b.max_irqs = 2;
+	b.inflation_total = 2100;
+	b.sum_irqs_sq = 4;
+	b.sum_irqs_inflation = 2 * 2100.0;
+	b.sum_inflation_sq = 2100.0 * 2100;
+
+	/* a single job does not determine a cost per interrupt */
+	ASSERT( litmus_irq_stats_fit(&a, &per_irq, &r2) == -1 );
+
+	litmus_irq_stats_merge(&a, &b);
+	ASSERT( a.jobs == 2 && a.irqs == 2 && a.max_irqs == 2 );
+	ASSERT( litmus_irq_stats_fit(&a, &per_irq, &r2) == 0 );
+	ASSERT( per_irq > 999.9 && per_irq < 1000.1 );
+	ASSERT( r2 > 0.999 );
+}
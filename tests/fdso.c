@@ -99,4 +99,52 @@ TESTCASE(not_inherit_od, GSN_EDF | PSN_EDF,
 	SYSCALL( remove(".fmlp_locks") );
 }
 
+TESTCASE(open_locks_batch, GSN_EDF | PSN_EDF | P_FP,
+	 "open many FMLP semaphores in one namespace at once")
+{
+	int ids[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+	int ods[8], od, i;
+
+	SYSCALL( litmus_open_locks(FMLP_SEM, ids, 8, ".fmlp_locks", NULL, ods) );
+
+	for (i = 1; i < 8; i++)
+		ASSERT( ods[i] != ods[i - 1] );
+
+	/* the cached namespace and the batch refer to the same resources */
+	SYSCALL( od = litmus_open_lock(FMLP_SEM, 9, ".fmlp_locks", NULL) );
+
+	SYSCALL( sporadic_partitioned(ms2ns(10), ms2ns(100), 0) );
+	SYSCALL( task_mode(LITMUS_RT_TASK) );
+
+	for (i = 0; i < 8; i++) {
+		SYSCALL( litmus_lock(ods[i]) );
+		SYSCALL( litmus_unlock(ods[i]) );
+	}
+
+	SYSCALL( task_mode(BACKGROUND_TASK) );
+
+	for (i = 0; i < 8; i++)
+		SYSCALL( od_close(ods[i]) );
+	SYSCALL( od_close(od) );
 
+	SYSCALL( remove(".fmlp_locks") );
+
+	/* a re-created namespace file must not be served from the cache */
+	SYSCALL( od = litmus_open_lock(FMLP_SEM, 0, ".fmlp_locks", NULL) );
+	SYSCALL( access(".fmlp_locks", F_OK) );
+	SYSCALL( od_close(od) );
+
+	SYSCALL( remove(".fmlp_locks") );
+}
+
+TESTCASE(open_locks_batch_fails, GSN_EDF | PSN_EDF | P_FP,
+	 "reject a batch of locks with an invalid protocol")
+{
+	int ids[2] = {0, 1};
+	int ods[2];
+
+	SYSCALL_FAILS( EINVAL,
+		litmus_open_locks(-1, ids, 2, ".fmlp_locks", NULL, ods) );
+
+	SYSCALL( remove(".fmlp_locks") );
+}
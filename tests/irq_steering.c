@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "tests.h"
+#include "irq_affinity.h"
+
+#define FAKE_PROC ".fake_proc"
+
+static const char fake_interrupts[] =
+	"           CPU0       CPU1       CPU3\n"
+	"  0:         10          0          5   IO-APIC   2-edge      timer\n"
+	"  9:          1          2          3   IO-APIC   9-fasteoi   acpi\n"
+	" 24:        100        200        300   PCI-MSI 512000-edge   eth0\n"
+	"NMI:          7          8          9   Non-maskable interrupts\n"
+	"LOC:       1000       2000       3000   Local timer interrupts\n"
+	"ERR:          4\n";
+
+static void write_fake(const char *fname, const char *contents)
+{
+	FILE *f;
+
+	SYSCALL( (f = fopen(fname, "w")) ? 0 : -1 );
+	fputs(contents, f);
+	fclose(f);
+}
+
+static void make_fake_irq(int irq, const char *affinity)
+{
+	char fname[64];
+
+	snprintf(fname, sizeof(fname), FAKE_PROC "/irq/%d", irq);
+	SYSCALL( mkdir(fname, 0755) );
+	strcat(fname, "/smp_affinity");
+	write_fake(fname, affinity);
+}
+
+static void remove_fake_irq(int irq)
+{
+	char fname[64];
+
+	snprintf(fname, sizeof(fname), FAKE_PROC "/irq/%d/smp_affinity", irq);
+	SYSCALL( remove(fname) );
+	snprintf(fname, sizeof(fname), FAKE_PROC "/irq/%d", irq);
+	SYSCALL( rmdir(fname) );
+}
+
+static void make_fake_proc(void)
+{
+	SYSCALL( mkdir(FAKE_PROC, 0755) );
+	SYSCALL( mkdir(FAKE_PROC "/irq", 0755) );
+	write_fake(FAKE_PROC "/interrupts", fake_interrupts);
+	make_fake_irq(0, "b\n");
+	make_fake_irq(9, "00000000,00000002\n");
+	make_fake_irq(24, "1\n");
+	SYSCALL( irq_set_proc_root(FAKE_PROC) );
+}
+
+static void remove_fake_proc(void)
+{
+	SYSCALL( irq_set_proc_root(NULL) );
+	remove_fake_irq(0);
+	remove_fake_irq(9);
+	remove_fake_irq(24);
+	SYSCALL( rmdir(FAKE_PROC "/irq") );
+	SYSCALL( remove(FAKE_PROC "/interrupts") );
+	SYSCALL( rmdir(FAKE_PROC) );
+}
+
+TESTCASE(irq_counts_fake_proc, ALL,
+	 "read per-CPU interrupt counts from a fake procfs")
+{
+	unsigned long long device[8], all[8];
+	int irqs[8];
+
+	make_fake_proc();
+
+	/* CPU2 is offline */
+	ASSERT( irq_read_counts(device, all, 8) == 4 );
+	ASSERT( device[0] == 111 && device[1] == 202 );
+	ASSERT( device[2] == 0 && device[3] == 308 );
+	ASSERT( all[0] == 1111 + 7 + 4 && all[1] == 2210 );
+	ASSERT( all[2] == 0 && all[3] == 3317 );
+
+	ASSERT( irq_list(irqs, 8) == 3 );
+	ASSERT( irqs[0] == 0 && irqs[1] == 9 && irqs[2] == 24 );
+	ASSERT( irq_list(irqs, 2) == 2 );
+
+	remove_fake_proc();
+}
+
+TESTCASE(irq_steer_fake_proc, ALL,
+	 "steer interrupts away from real-time CPUs in a fake procfs")
+{
+	unsigned long long mask;
+	int moved, failed;
+
+	make_fake_proc();
+
+	ASSERT( irq_get_affinity(9, &mask) == 0 && mask == 0x2 );
+	SYSCALL_FAILS( EINVAL, irq_set_affinity(9, 0) );
+
+	/* CPUs 1 and 3 run real-time tasks, CPU 0 handles interrupts */
+	SYSCALL( irq_steer_away(0xa, 0x1, &moved, &failed) );
+	ASSERT( moved == 2 && failed == 0 );
+
+	/* CPUs 0, 1, 3: keep CPU 0 */
+	ASSERT( irq_get_affinity(0, &mask) == 0 && mask == 0x1 );
+	/* only CPU 1: moved to CPU 0 */
+	ASSERT( irq_get_affinity(9, &mask) == 0 && mask == 0x1 );
+	ASSERT( irq_get_affinity(24, &mask) == 0 && mask == 0x1 );
+
+	/* masks beyond 32 CPUs are written in groups of 32 bits */
+	SYSCALL( irq_set_affinity(24, 0x100000001ULL) );
+	ASSERT( irq_get_affinity(24, &mask) == 0 && mask == 0x100000001ULL );
+
+	SYSCALL_FAILS( EINVAL, irq_steer_away(0xa, 0, NULL, NULL) );
+
+	remove_fake_proc();
+}
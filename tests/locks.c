@@ -1,6 +1,8 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/wait.h> /* for waitpid() */
 
 #include "tests.h"
@@ -110,6 +112,177 @@ TESTCASE(lock_fmlp, PSN_EDF | GSN_EDF | P_FP,
 	SYSCALL( remove(".fmlp_locks") );
 }
 
+TESTCASE(lock_fmlp_fast, PSN_EDF | GSN_EDF | P_FP,
+	 "FMLP acquisition and release with userspace fast path")
+{
+	int od;
+
+	SYSCALL( sporadic_partitioned(ms2ns(10), ms2ns(100), 0) );
+	SYSCALL( task_mode(LITMUS_RT_TASK) );
+
+	SYSCALL( od = litmus_open_fast_lock(FMLP_SEM, 3, ".fmlp_locks", NULL) );
+
+	SYSCALL( litmus_lock(od) );
+	SYSCALL( litmus_unlock(od) );
+
+	SYSCALL( litmus_lock(od) );
+	SYSCALL( litmus_unlock(od) );
+
+	SYSCALL( litmus_lock(od) );
+	SYSCALL( litmus_unlock(od) );
+
+	/* tasks may not unlock resources they don't own */
+	SYSCALL_FAILS(EINVAL, litmus_unlock(od) );
+
+	SYSCALL( od_close(od) );
+
+	SYSCALL( remove(".fmlp_locks") );
+}
+
+TESTCASE(fast_lock_fmlp_only, ALL,
+	 "reject userspace fast path for protocols other than the FMLP")
+{
+	SYSCALL_FAILS(EINVAL,
+		litmus_open_fast_lock(SRP_SEM, 0, ".srp_locks", NULL) );
+	SYSCALL_FAILS(EINVAL,
+		litmus_open_fast_lock(MPCP_SEM, 0, ".mpcp_locks", NULL) );
+	SYSCALL_FAILS(EINVAL,
+		litmus_open_fast_lock(FMLP_SEM, -1, ".fmlp_locks", NULL) );
+}
+
+#define FAST_PROCS 2
+#define FAST_ITERATIONS 1000
+
+TESTCASE(fast_lock_contention, PSN_EDF | GSN_EDF | P_FP,
+	 "FMLP fast path provides mutual exclusion across processes")
+{
+	struct {
+		unsigned long count, inside, overlaps;
+	} *shared;
+	pid_t pid[FAST_PROCS];
+	unsigned long long mask;
+	int i, j, od, status, domains;
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT( shared != MAP_FAILED );
+	shared->count = shared->inside = shared->overlaps = 0;
+
+	for (domains = 0; domain_to_cpus(domains, &mask) == 0; domains++)
+		;
+	ASSERT( domains > 0 );
+
+	for (i = 0; i < FAST_PROCS; i++) {
+		pid[i] = fork();
+		ASSERT( pid[i] != -1 );
+		if (pid[i] == 0) {
+			SYSCALL( sporadic_partitioned(ms2ns(100), ms2ns(100),
+				i % domains) );
+			SYSCALL( task_mode(LITMUS_RT_TASK) );
+
+			SYSCALL( od = litmus_open_fast_lock(FMLP_SEM, 5,
+					".fmlp_locks", NULL) );
+
+			for (j = 0; j < FAST_ITERATIONS; j++) {
+				SYSCALL( litmus_lock(od) );
+				if (shared->inside++)
+					shared->overlaps++;
+				shared->count++;
+				shared->inside--;
+				SYSCALL( litmus_unlock(od) );
+			}
+
+			SYSCALL( od_close(od) );
+			SYSCALL( task_mode(BACKGROUND_TASK) );
+			exit(0);
+		}
+	}
+
+	for (i = 0; i < FAST_PROCS; i++) {
+		SYSCALL( waitpid(pid[i], &status, 0) );
+		ASSERT( WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+	}
+
+	ASSERT( shared->count == FAST_PROCS * FAST_ITERATIONS );
+	ASSERT( shared->overlaps == 0 );
+	munmap(shared, sizeof(*shared));
+
+	SYSCALL( remove(".fmlp_locks") );
+}
+
+TESTCASE(lock_stats_fmlp, PSN_EDF | GSN_EDF | P_FP,
+	 "account FMLP blocking and hold times")
+{
+	struct litmus_lock_stats stats;
+	uint64_t waits = 0, holds = 0;
+	int od, i;
+
+	SYSCALL( sporadic_partitioned(ms2ns(10), ms2ns(100), 0) );
+	SYSCALL( task_mode(LITMUS_RT_TASK) );
+
+	SYSCALL( od = litmus_open_lock(FMLP_SEM, 0, ".fmlp_locks", NULL) );
+
+	litmus_lock_stats_reset();
+	litmus_lock_stats_enable(1);
+
+	for (i = 0; i < 3; i++) {
+		SYSCALL( litmus_lock(od) );
+		SYSCALL( litmus_unlock(od) );
+	}
+	SYSCALL_FAILS(EINVAL, litmus_unlock(od) );
+
+	litmus_lock_stats_enable(0);
+
+	/* not accounted while disabled */
+	SYSCALL( litmus_lock(od) );
+	SYSCALL( litmus_unlock(od) );
+
+	SYSCALL( litmus_lock_stats_get(od, &stats) );
+	ASSERT( stats.acquisitions == 3 );
+	ASSERT( stats.failures == 0 );
+	ASSERT( stats.wait_max > 0 && stats.wait_max <= stats.wait_total );
+	ASSERT( stats.hold_max <= stats.hold_total );
+	for (i = 0; i < LITMUS_LOCK_STATS_BUCKETS; i++) {
+		waits += stats.wait_hist[i];
+		holds += stats.hold_hist[i];
+	}
+	ASSERT( waits == 3 );
+	ASSERT( holds == 3 );
+
+	SYSCALL( od_close(od) );
+
+	SYSCALL( remove(".fmlp_locks") );
+}
+
+TESTCASE(lock_stats_merge, ALL,
+	 "merge lock statistics")
+{
+	struct litmus_lock_stats a, b;
+
+	memset(&a, 0, sizeof(a));
+	memset(&b, 0, sizeof(b));
+	a.acquisitions = 2;
+	a.wait_total = 30;
+	a.wait_max = 20;
+	a.wait_hist[4] = 2;
+	b.acquisitions = 1;
+	b.failures = 1;
+	b.wait_total = 100;
+	b.wait_max = 100;
+	b.wait_hist[6] = 1;
+
+	litmus_lock_stats_merge(&a, &b);
+	ASSERT( a.acquisitions == 3 );
+	ASSERT( a.failures == 1 );
+	ASSERT( a.wait_total == 130 );
+	ASSERT( a.wait_max == 100 );
+	ASSERT( a.wait_hist[4] == 2 && a.wait_hist[6] == 1 );
+
+	SYSCALL_FAILS(EINVAL, litmus_lock_stats_get(-1, &a) );
+	SYSCALL_FAILS(EINVAL,
+		litmus_lock_stats_get(LITMUS_LOCK_STATS_MAX_OD, &a) );
+}
+
 TESTCASE(lock_dflp, P_FP,
 	 "DFLP acquisition and release")
 {
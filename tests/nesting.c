@@ -40,6 +40,32 @@ TESTCASE(lock_fmlp_nesting, PSN_EDF | GSN_EDF | P_FP,
 	SYSCALL( remove(".fmlp_locks") );
 }
 
+TESTCASE(lock_fmlp_fast_nesting, PSN_EDF | GSN_EDF | P_FP,
+	 "FMLP no nesting allowed with the userspace fast path")
+{
+	int od, od2;
+
+	SYSCALL( sporadic_partitioned(10, 100, 0) );
+	SYSCALL( task_mode(LITMUS_RT_TASK) );
+
+	SYSCALL( od = litmus_open_fast_lock(FMLP_SEM, 0, ".fmlp_locks", NULL) );
+	SYSCALL( od2 = litmus_open_lock(FMLP_SEM, 1, ".fmlp_locks", NULL) );
+
+	/* the kernel does not know about the fast-path holder */
+	SYSCALL( litmus_lock(od) );
+	SYSCALL_FAILS(EBUSY, litmus_lock(od2));
+	SYSCALL( litmus_unlock(od) );
+
+	SYSCALL( litmus_lock(od2) );
+	SYSCALL_FAILS(EBUSY, litmus_lock(od));
+	SYSCALL( litmus_unlock(od2) );
+
+	SYSCALL( od_close(od) );
+	SYSCALL( od_close(od2) );
+
+	SYSCALL( remove(".fmlp_locks") );
+}
+
 TESTCASE(lock_fmlp_srp_nesting, NONE,
 	 "FMLP no nesting with SRP resources allowed")
 {
@@ -564,3 +590,76 @@ TESTCASE(lock_dflp_pcp_no_nesting, P_FP,
 
 	SYSCALL( remove(namespace) );
 }
+
+TESTCASE(lock_pcp_group, P_FP,
+	 "PCP group acquisition and release")
+{
+	int fd, od, od2, group[2], dup[2];
+
+	SYSCALL( fd = open(".pcp_locks", O_RDONLY | O_CREAT, S_IRUSR) );
+
+	SYSCALL( sporadic_partitioned(10, 100, 0) );
+	SYSCALL( task_mode(LITMUS_RT_TASK) );
+
+	SYSCALL( od = open_pcp_sem(fd, 0, 0) );
+	SYSCALL( od2 = open_pcp_sem(fd, 1, 0) );
+
+	/* any order is fine */
+	group[0] = od2;
+	group[1] = od;
+
+	SYSCALL( litmus_lock_group(group, 2) );
+	SYSCALL( litmus_unlock_group(group, 2) );
+
+	SYSCALL( litmus_lock_group(group, 2) );
+	SYSCALL( litmus_unlock_group(group + 1, 1) );
+	SYSCALL( litmus_unlock(od2) );
+
+	/* all locks were released */
+	SYSCALL_FAILS(EINVAL, litmus_unlock(od) );
+	SYSCALL_FAILS(EINVAL, litmus_unlock(od2) );
+
+	dup[0] = dup[1] = od;
+	SYSCALL_FAILS(EINVAL, litmus_lock_group(dup, 2) );
+	SYSCALL_FAILS(EINVAL, litmus_lock_group(group, 0) );
+	SYSCALL_FAILS(EINVAL,
+		litmus_lock_group(group, LITMUS_MAX_LOCK_GROUP + 1) );
+
+	SYSCALL( od_close(od) );
+	SYSCALL( od_close(od2) );
+
+	SYSCALL( close(fd) );
+
+	SYSCALL( remove(".pcp_locks") );
+}
+
+TESTCASE(lock_fmlp_group_rollback, PSN_EDF | GSN_EDF | P_FP,
+	 "FMLP group acquisition fails and releases partial group")
+{
+	int fd, od, od2, group[2];
+
+	SYSCALL( fd = open(".fmlp_locks", O_RDONLY | O_CREAT, S_IRUSR) );
+
+	SYSCALL( sporadic_partitioned(10, 100, 0) );
+	SYSCALL( task_mode(LITMUS_RT_TASK) );
+
+	SYSCALL( group[0] = od = open_fmlp_sem(fd, 0) );
+	SYSCALL( group[1] = od2 = open_fmlp_sem(fd, 1) );
+
+	/* FMLP locks cannot be nested */
+	SYSCALL_FAILS(EBUSY, litmus_lock_group(group, 2) );
+
+	/* neither lock is held afterwards */
+	SYSCALL_FAILS(EINVAL, litmus_unlock(od) );
+	SYSCALL_FAILS(EINVAL, litmus_unlock(od2) );
+
+	SYSCALL( litmus_lock_group(group, 1) );
+	SYSCALL( litmus_unlock_group(group, 1) );
+
+	SYSCALL( od_close(od) );
+	SYSCALL( od_close(od2) );
+
+	SYSCALL( close(fd) );
+
+	SYSCALL( remove(".fmlp_locks") );
+}
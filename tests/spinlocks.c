@@ -0,0 +1,119 @@
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h> /* for waitpid() */
+
+#include "tests.h"
+#include "litmus.h"
+#include "spinlock.h"
+
+#define NUM_PROCS 3
+#define ITERATIONS 1000
+
+struct shared_counter {
+	struct litmus_ticket_lock ticket;
+	unsigned long count;
+	unsigned long inside;
+	unsigned long overlaps;
+	struct litmus_mcs_lock mcs;
+	/* the MCS lock's nodes follow */
+};
+
+/* Have NUM_PROCS processes increment a shared counter under either lock;
+ * returns the counter's final value. */
+static unsigned long count_with(int use_mcs, unsigned long *overlaps)
+{
+	struct shared_counter *shared;
+	size_t size = sizeof(*shared) + NUM_PROCS * sizeof(struct litmus_mcs_node);
+	pid_t pid[NUM_PROCS];
+	unsigned long long mask;
+	unsigned long count;
+	int i, j, status, domains;
+
+	shared = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT( shared != MAP_FAILED );
+
+	litmus_ticket_init(&shared->ticket);
+	litmus_mcs_init(&shared->mcs, NUM_PROCS);
+	shared->count = shared->inside = shared->overlaps = 0;
+
+	for (domains = 0; domain_to_cpus(domains, &mask) == 0; domains++)
+		;
+	ASSERT( domains > 0 );
+
+	for (i = 0; i < NUM_PROCS; i++) {
+		pid[i] = fork();
+		ASSERT( pid[i] != -1 );
+		if (pid[i] == 0) {
+			/* non-preemptive sections apply only to RT tasks */
+			SYSCALL( sporadic_partitioned(ms2ns(100), ms2ns(100),
+				i % domains) );
+			SYSCALL( task_mode(LITMUS_RT_TASK) );
+
+			for (j = 0; j < ITERATIONS; j++) {
+				if (use_mcs)
+					litmus_mcs_lock(&shared->mcs, i);
+				else
+					litmus_ticket_lock(&shared->ticket);
+
+				if (shared->inside++)
+					shared->overlaps++;
+				shared->count++;
+				shared->inside--;
+
+				if (use_mcs)
+					litmus_mcs_unlock(&shared->mcs, i);
+				else
+					litmus_ticket_unlock(&shared->ticket);
+			}
+
+			SYSCALL( task_mode(BACKGROUND_TASK) );
+			exit(0);
+		}
+	}
+
+	for (i = 0; i < NUM_PROCS; i++) {
+		SYSCALL( waitpid(pid[i], &status, 0) );
+		ASSERT( WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+	}
+
+	count = shared->count;
+	*overlaps = shared->overlaps;
+	munmap(shared, size);
+	return count;
+}
+
+TESTCASE(ticket_lock_mutex, PSN_EDF | GSN_EDF | P_FP,
+	 "ticket spin locks provide mutual exclusion across processes")
+{
+	unsigned long overlaps;
+
+	ASSERT( count_with(0, &overlaps) == NUM_PROCS * ITERATIONS );
+	ASSERT( overlaps == 0 );
+}
+
+TESTCASE(mcs_lock_mutex, PSN_EDF | GSN_EDF | P_FP,
+	 "MCS spin locks provide mutual exclusion across processes")
+{
+	unsigned long overlaps;
+
+	ASSERT( count_with(1, &overlaps) == NUM_PROCS * ITERATIONS );
+	ASSERT( overlaps == 0 );
+}
+
+TESTCASE(spin_lock_np, LITMUS,
+	 "spin lock holders are non-preemptive")
+{
+	struct litmus_ticket_lock lock;
+	struct control_page *cp;
+
+	SYSCALL( init_rt_thread() );
+	cp = get_ctrl_page();
+	ASSERT( cp != NULL );
+
+	litmus_ticket_init(&lock);
+	litmus_ticket_lock(&lock);
+	ASSERT( cp->sched.np.flag );
+	litmus_ticket_unlock(&lock);
+	ASSERT( !cp->sched.np.flag );
+}